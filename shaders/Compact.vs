@@ -0,0 +1,75 @@
+#version 440 core
+
+// Compact 16 byte vertex, see CompactVertex in MeshData.h
+layout(location = 0) in vec3 aPos;      // unorm16, relative to the mesh bounds
+layout(location = 1) in uint aMaterial;
+layout(location = 2) in vec2 aNormal;   // Octahedral snorm16
+layout(location = 3) in vec2 aTexCoord; // Half floats
+
+struct Material {
+    vec3 diffuseColor;
+    float opacity;
+    int textureIndex;
+};
+
+layout(std430, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
+
+uniform vec3 boundsMin;
+uniform vec3 boundsExtent;
+
+// Per instance, see InstanceData in Object.h
+struct Instance {
+    mat4 model;
+    vec4 tint;
+};
+
+layout(std430, binding = 1) readonly buffer Instances {
+    Instance instances[];
+};
+
+// Written once per frame, see FrameData in Camera.h
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+    mat4 inverseViewProjection;
+};
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out int TexID;
+flat out vec3 DiffuseColor;
+flat out float Opacity;
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    vec3 position = boundsMin + aPos * boundsExtent;
+    mat4 model = instances[gl_InstanceID].model;
+
+    // Transform the vertex into clip space
+    vec4 worldPos = model * vec4(position, 1.0);
+    gl_Position = viewProjection * worldPos;
+
+    FragPos = worldPos.xyz;
+    Normal = mat3(transpose(inverse(model))) * octahedralDecode(aNormal);
+
+    // Passing attributes to the fragment shader
+    TexCoord = aTexCoord;
+    Material material = materials[aMaterial];
+    TexID = material.textureIndex;
+    DiffuseColor = material.diffuseColor * instances[gl_InstanceID].tint.rgb;
+    Opacity = material.opacity;
+}
@@ -0,0 +1,102 @@
+#version 440 core
+
+// Shades every pixel of the G-buffer once, see DeferredRenderer
+
+// G-buffer, on the units after the texture arrays
+layout(binding = 16) uniform sampler2D gAlbedo;
+layout(binding = 17) uniform sampler2D gNormal;
+layout(binding = 18) uniform sampler2D gDepth;
+
+// Written once per frame, see FrameData in Camera.h
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+    mat4 inverseViewProjection;
+};
+
+// Every light of the scene, see LightBuffer
+struct Light {
+    vec4 position;       // w radius
+    vec4 colorIntensity; // rgb color, a intensity
+};
+
+layout(std430, binding = 3) readonly buffer Lights {
+    uint lightCount;
+    Light lights[];
+};
+
+// Lights touching each cluster of the view frustum, see LightClusters
+layout(std430, binding = 4) readonly buffer LightClusters {
+    vec4 clusterParams; // near, slices / log(far / near), tile width, tile height
+    uvec4 clusterGrid;
+    uvec2 clusterRanges[]; // Offset into lightIndices and count
+};
+
+layout(std430, binding = 5) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+uniform float ambientLight;
+uniform vec3 ambientLightColor;
+
+out vec4 FragColor;
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float fragDepth = texelFetch(gDepth, pixel, 0).r;
+    if (fragDepth == 1.0) discard; // Nothing drawn here
+
+    vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+    vec3 color = albedo.rgb;
+    if (albedo.a == 0.0) {
+        // Fullbright
+        FragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+        return;
+    }
+
+    // World position back from the depth buffer
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(gDepth, 0));
+    vec4 world = inverseViewProjection * vec4(vec3(uv, fragDepth) * 2.0 - 1.0, 1.0);
+    vec3 FragPos = world.xyz / world.w;
+    vec3 norm = octahedralDecode(texelFetch(gNormal, pixel, 0).rg);
+
+    // Same lighting as the forward path in Shader.fs
+    vec3 diffuse = vec3(0.0);
+
+    // Only the lights of this fragment's cluster
+    float depth = -(view * vec4(FragPos, 1.0)).z;
+    uint slice = uint(clamp(floor(log(max(depth, clusterParams.x) / clusterParams.x) * clusterParams.y),
+                            0.0, float(clusterGrid.z - 1)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterParams.zw), clusterGrid.xy - 1);
+    uvec2 range = clusterRanges[(slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x];
+
+    for (uint i = 0; i < range.y; ++i) {
+        Light light = lights[lightIndices[range.x + i]];
+        vec3 lightDir = normalize(light.position.xyz - FragPos);
+        float ndotl = max(dot(norm, lightDir), 0.0);
+
+        // Distance attenuation, windowed to reach zero at the light's radius
+        float distance = length(light.position.xyz - FragPos);
+        if (distance < 1e-6) distance = 1e-6;
+        float window = clamp(1.0 - pow(distance / light.position.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / max(distance * distance, 1e-6);
+
+        diffuse += light.colorIntensity.rgb * light.colorIntensity.a * ndotl * attenuation;
+    }
+    diffuse *= color;
+
+    vec3 ambient = color * ambientLightColor * ambientLight;
+    FragColor = vec4(clamp(diffuse + ambient, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,46 @@
+#version 440 core
+
+#define MAX_TEXTURE_ARRAYS 16
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoord;
+flat in int TexID; // TextureCache handle
+flat in vec3 DiffuseColor;
+flat in float Opacity;
+
+// One array per image size and format on units 0 .. MAX_TEXTURE_ARRAYS - 1,
+// and the array and layer of every texture handle. See TextureCache::bind.
+layout(binding = 0) uniform sampler2DArray textureArrays[MAX_TEXTURE_ARRAYS];
+layout(std430, binding = 2) readonly buffer TextureSlots {
+    ivec2 textureSlots[];
+};
+
+uniform bool useLighting;
+
+// Compact G-buffer, see DeferredRenderer
+layout(location = 0) out vec4 Albedo; // rgb color, a 1 when lit and 0 for fullbright
+layout(location = 1) out vec2 EncodedNormal; // Octahedral, snorm16
+
+vec2 octahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0)
+        e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+
+void main()
+{
+    vec3 color = DiffuseColor;
+
+    // Texture
+    if (TexID >= 0) {
+        ivec2 slot = textureSlots[TexID];
+        color *= texture(textureArrays[slot.x], vec3(TexCoord, slot.y)).rgb;
+    }
+
+    Albedo = vec4(color, useLighting ? 1.0 : 0.0);
+    EncodedNormal = octahedralEncode(normalize(Normal));
+}
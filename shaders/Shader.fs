@@ -1,22 +1,54 @@
 #version 440 core
 
-#define MAX_TEXTURES 16
-#define MAX_LIGHTS 16
+#define MAX_TEXTURE_ARRAYS 16
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
-flat in int TexID;
+flat in int TexID; // TextureCache handle
 flat in vec3 DiffuseColor;
 flat in float Opacity;
 
-uniform sampler2D textures[MAX_TEXTURES];
+// One array per image size and format on units 0 .. MAX_TEXTURE_ARRAYS - 1,
+// and the array and layer of every texture handle. See TextureCache::bind.
+layout(binding = 0) uniform sampler2DArray textureArrays[MAX_TEXTURE_ARRAYS];
+layout(std430, binding = 2) readonly buffer TextureSlots {
+    ivec2 textureSlots[];
+};
+
+// Written once per frame, see FrameData in Camera.h
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+    mat4 inverseViewProjection;
+};
+
+// Every light of the scene, see LightBuffer
+struct Light {
+    vec4 position;       // w radius
+    vec4 colorIntensity; // rgb color, a intensity
+};
+
+layout(std430, binding = 3) readonly buffer Lights {
+    uint lightCount;
+    Light lights[];
+};
+
+// Lights touching each cluster of the view frustum, see LightClusters
+layout(std430, binding = 4) readonly buffer LightClusters {
+    vec4 clusterParams; // near, slices / log(far / near), tile width, tile height
+    uvec4 clusterGrid;
+    uvec2 clusterRanges[]; // Offset into lightIndices and count
+};
+
+layout(std430, binding = 5) readonly buffer LightIndices {
+    uint lightIndices[];
+};
 
 uniform bool useLighting;
-uniform int numLights;
-uniform vec3 lightPositions[MAX_LIGHTS];
-uniform vec3 lightColors[MAX_LIGHTS];
-uniform float lightIntensities[MAX_LIGHTS];
 
 uniform float ambientLight;
 uniform vec3 ambientLightColor;
@@ -30,7 +62,8 @@ void main()
 
     // Texture
     if (TexID >= 0) {
-        vec4 texColor = texture(textures[TexID], TexCoord);
+        ivec2 slot = textureSlots[TexID];
+        vec4 texColor = texture(textureArrays[slot.x], vec3(TexCoord, slot.y));
         color *= texColor.rgb;
         alpha *= texColor.a;
     }
@@ -40,16 +73,25 @@ void main()
         vec3 diffuse = vec3(0.0);
         vec3 norm = normalize(Normal);
 
-        for (int i = 0; i < numLights; ++i) {
-            vec3 lightDir = normalize(lightPositions[i] - FragPos);
+        // Only the lights of this fragment's cluster
+        float depth = -(view * vec4(FragPos, 1.0)).z;
+        uint slice = uint(clamp(floor(log(max(depth, clusterParams.x) / clusterParams.x) * clusterParams.y),
+                                0.0, float(clusterGrid.z - 1)));
+        uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterParams.zw), clusterGrid.xy - 1);
+        uvec2 range = clusterRanges[(slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x];
+
+        for (uint i = 0; i < range.y; ++i) {
+            Light light = lights[lightIndices[range.x + i]];
+            vec3 lightDir = normalize(light.position.xyz - FragPos);
             float ndotl = max(dot(norm, lightDir), 0.0);
 
-            // Distance attenuation
-            float distance = length(lightPositions[i] - FragPos);
+            // Distance attenuation, windowed to reach zero at the light's radius
+            float distance = length(light.position.xyz - FragPos);
             if (distance < 1e-6) distance = 1e-6;
-            float attenuation = 1.0 / max(distance * distance, 1e-6);
+            float window = clamp(1.0 - pow(distance / light.position.w, 4.0), 0.0, 1.0);
+            float attenuation = window * window / max(distance * distance, 1e-6);
 
-            diffuse += lightColors[i] * lightIntensities[i] * ndotl * attenuation;
+            diffuse += light.colorIntensity.rgb * light.colorIntensity.a * ndotl * attenuation;
         }
         diffuse *= color;
 
@@ -7,9 +7,25 @@ layout(location = 3) in int aTexID;
 layout(location = 4) in vec3 aDiffuseColor;
 layout(location = 5) in float aOpacity;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Per instance, see InstanceData in Object.h
+struct Instance {
+    mat4 model;
+    vec4 tint;
+};
+
+layout(std430, binding = 1) readonly buffer Instances {
+    Instance instances[];
+};
+
+// Written once per frame, see FrameData in Camera.h
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+    mat4 inverseViewProjection;
+};
 
 out vec3 FragPos;
 out vec3 Normal;
@@ -20,16 +36,18 @@ flat out float Opacity;
 
 void main()
 {
-    // Transform the vertex into clip space
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    mat4 model = instances[gl_InstanceID].model;
 
+    // Transform the vertex into clip space
     vec4 worldPos = model * vec4(aPos, 1.0);
+    gl_Position = viewProjection * worldPos;
+
     FragPos = worldPos.xyz;
     Normal = mat3(transpose(inverse(model))) * aNormal;
 
     // Passing attributes to the fragment shader
     TexCoord = aTexCoord; // Rasteriser will interpolate the UV
     TexID = aTexID;
-    DiffuseColor = aDiffuseColor;
+    DiffuseColor = aDiffuseColor * instances[gl_InstanceID].tint.rgb;
     Opacity = aOpacity;
 }
@@ -0,0 +1,59 @@
+#include "AssetLoader.h"
+#include <chrono>
+#include <iostream>
+
+AssetLoader::AssetLoader(ThreadPool& pool) : pool(pool) {}
+
+AssetLoader::~AssetLoader() {
+    // Jobs push into this loader, so they have to finish first
+    for (auto& job : jobs)
+        job.wait();
+}
+
+void AssetLoader::load(std::shared_ptr<Mesh> mesh, const std::string& path) {
+    jobs.push_back(pool.submit([this, mesh, path]() {
+        auto startTime = std::chrono::steady_clock::now();
+
+        Payload payload{mesh, path, MeshData::load(path), 0.0};
+        payload.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(std::move(payload));
+    }));
+}
+
+void AssetLoader::update(double budgetMs) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    while (true) {
+        Payload payload;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ready.empty()) break;
+            payload = std::move(ready.front());
+            ready.pop_front();
+        }
+
+        auto uploadStart = std::chrono::steady_clock::now();
+        payload.mesh->upload(std::move(payload.data));
+        double uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+        std::cout << "Async load " << payload.path << ": " << payload.loadMs << " ms on worker, "
+                  << uploadMs << " ms upload" << std::endl;
+
+        double spent = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        if (spent >= budgetMs) break;
+    }
+
+    // Forget finished jobs
+    std::erase_if(jobs, [](std::future<void>& job) {
+        return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    });
+}
+
+bool AssetLoader::idle() {
+    std::erase_if(jobs, [](std::future<void>& job) {
+        return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    });
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.empty() && ready.empty();
+}
@@ -0,0 +1,20 @@
+#include "Camera.h"
+#include <glad/gl.h>
+
+void Camera::uploadFrameData(float time) {
+    FrameData frame;
+    frame.view = GetViewMatrix();
+    frame.projection = projectionMatrix;
+    frame.viewProjection = projectionMatrix * frame.view;
+    frame.cameraPosition = glm::vec4(position, 1.0f);
+    frame.time = time;
+    frame.inverseViewProjection = glm::inverse(frame.viewProjection);
+
+    // Orphaned every frame so the write never waits on draws of the last one
+    if (frameBuffer == 0)
+        glGenBuffers(1, &frameBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), &frame, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, frameBuffer);
+}
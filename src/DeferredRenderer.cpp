@@ -0,0 +1,97 @@
+#include "DeferredRenderer.h"
+#include <iostream>
+
+DeferredRenderer::DeferredRenderer(const char* vertexPath)
+    : geometryShader(vertexPath, "shaders/GBuffer.fs"),
+      lightingShader("shaders/Deferred.vs", "shaders/Deferred.fs") {
+    glGenVertexArrays(1, &emptyVAO);
+}
+
+void DeferredRenderer::release() {
+    deleteTargets();
+    glDeleteVertexArrays(1, &emptyVAO);
+    emptyVAO = 0;
+}
+
+static unsigned int createTarget(GLenum internalFormat, int width, int height) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+void DeferredRenderer::createTargets(int width, int height) {
+    deleteTargets();
+    this->width = width;
+    this->height = height;
+
+    albedoTexture = createTarget(GL_RGBA8, width, height);
+    normalTexture = createTarget(GL_RG16_SNORM, width, height);
+    // Same format as the default framebuffer's depth, which it gets blitted into
+    depthTexture = createTarget(GL_DEPTH24_STENCIL8, width, height);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "G-buffer framebuffer is incomplete" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::deleteTargets() {
+    if (!framebuffer) return;
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &albedoTexture);
+    glDeleteTextures(1, &normalTexture);
+    glDeleteTextures(1, &depthTexture);
+    framebuffer = albedoTexture = normalTexture = depthTexture = 0;
+}
+
+void DeferredRenderer::beginGeometry(int width, int height) {
+    if (width != this->width || height != this->height || !framebuffer)
+        createTargets(width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void DeferredRenderer::shade(const glm::vec3& ambientColor, float ambient) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Every pixel once, whatever the depth complexity of the geometry was
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_UNIT);
+    glBindTexture(GL_TEXTURE_2D, albedoTexture);
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_UNIT + 1);
+    glBindTexture(GL_TEXTURE_2D, normalTexture);
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_UNIT + 2);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    lightingShader.use();
+    lightingShader.setVec3("ambientLightColor", ambientColor);
+    lightingShader.setFloat("ambientLight", ambient);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,39 @@
+#include "LightBuffer.h"
+#include <glad/gl.h>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+static bool sameLight(const Light& a, const Light& b) {
+    return a.position == b.position && a.color == b.color && a.intensity == b.intensity && a.radius == b.radius;
+}
+
+void LightBuffer::update(const std::vector<Light>& lights) {
+    bool changed = buffer == 0 || lights.size() != uploaded.size() ||
+                   !std::equal(lights.begin(), lights.end(), uploaded.begin(), sameLight);
+    if (changed) {
+        // A count padded to 16 bytes, then the lights
+        std::vector<uint8_t> data(16 + lights.size() * sizeof(GPULight));
+        uint32_t count = lights.size();
+        std::memcpy(data.data(), &count, sizeof(count));
+        GPULight* gpuLights = reinterpret_cast<GPULight*>(data.data() + 16);
+        for (size_t i = 0; i < lights.size(); ++i) {
+            gpuLights[i].position = glm::vec4(lights[i].position, lights[i].radius);
+            gpuLights[i].colorIntensity = glm::vec4(lights[i].color, lights[i].intensity);
+        }
+
+        // Reallocate only to grow, otherwise overwrite in place
+        if (buffer == 0) glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        if (lights.size() > capacity || capacity == 0) {
+            capacity = std::max<size_t>(lights.size(), 1);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, 16 + capacity * sizeof(GPULight), nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data.size(), data.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        uploaded = lights;
+        uploads++;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, buffer);
+}
@@ -0,0 +1,200 @@
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include <glad/gl.h>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+static unsigned int clusterIndex(unsigned int x, unsigned int y, unsigned int z) {
+    return (z * LightClusters::GRID_Y + y) * LightClusters::GRID_X + x;
+}
+
+void LightClusters::buildBounds(const glm::mat4& projection, float nearPlane, float farPlane) {
+    boundsMin.resize(GRID_X * GRID_Y * GRID_Z);
+    boundsMax.resize(GRID_X * GRID_Y * GRID_Z);
+    glm::mat4 inverseProjection = glm::inverse(projection);
+
+    // View space direction through a point in NDC, scaled to one unit of depth
+    auto ray = [&](float x, float y) {
+        glm::vec4 p = inverseProjection * glm::vec4(x, y, -1.0f, 1.0f);
+        glm::vec3 v = glm::vec3(p) / p.w;
+        return v / -v.z;
+    };
+
+    for (unsigned int z = 0; z < GRID_Z; ++z) {
+        float sliceNear = nearPlane * std::pow(farPlane / nearPlane, (float)z / GRID_Z);
+        float sliceFar = nearPlane * std::pow(farPlane / nearPlane, (float)(z + 1) / GRID_Z);
+        for (unsigned int y = 0; y < GRID_Y; ++y) {
+            for (unsigned int x = 0; x < GRID_X; ++x) {
+                float x0 = (float)x / GRID_X * 2.0f - 1.0f, x1 = (float)(x + 1) / GRID_X * 2.0f - 1.0f;
+                float y0 = (float)y / GRID_Y * 2.0f - 1.0f, y1 = (float)(y + 1) / GRID_Y * 2.0f - 1.0f;
+                glm::vec3 corners[4] = {ray(x0, y0), ray(x1, y0), ray(x0, y1), ray(x1, y1)};
+                glm::vec3 lo(1e30f), hi(-1e30f);
+                for (const glm::vec3& corner : corners) {
+                    for (float depth : {sliceNear, sliceFar}) {
+                        lo = glm::min(lo, corner * depth);
+                        hi = glm::max(hi, corner * depth);
+                    }
+                }
+                boundsMin[clusterIndex(x, y, z)] = lo;
+                boundsMax[clusterIndex(x, y, z)] = hi;
+            }
+        }
+    }
+    boundsProjection = projection;
+    boundsNear = nearPlane;
+    boundsFar = farPlane;
+}
+
+void LightClusters::update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+                           float nearPlane, float farPlane, int viewportWidth, int viewportHeight) {
+    auto start = std::chrono::steady_clock::now();
+    if (projection != boundsProjection || nearPlane != boundsNear || farPlane != boundsFar)
+        buildBounds(projection, nearPlane, farPlane);
+
+    float sliceScale = GRID_Z / std::log(farPlane / nearPlane);
+    auto slice = [&](float depth) {
+        int z = (int)std::floor(std::log(std::max(depth, nearPlane) / nearPlane) * sliceScale);
+        return std::clamp(z, 0, (int)GRID_Z - 1);
+    };
+
+    // Slices and tiles each light may touch, from its view space bounding box
+    struct Extent {
+        glm::vec3 center;
+        int z0, z1, x0, x1, y0, y1; // Inclusive, z0 > z1 when out of view
+    };
+    std::vector<Extent> extents(lights.size());
+    ThreadPool::shared().parallelFor((lights.size() + 255) / 256, [&](size_t block) {
+        size_t end = std::min(lights.size(), (block + 1) * 256);
+        for (size_t i = block * 256; i < end; ++i) {
+            Extent& e = extents[i];
+            float r = lights[i].radius;
+            e.center = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+            float depth = -e.center.z;
+            if (depth + r < nearPlane || depth - r > farPlane) { e.z0 = 1; e.z1 = 0; continue; }
+            e.z0 = slice(depth - r);
+            e.z1 = slice(depth + r);
+            e.x0 = 0; e.x1 = GRID_X - 1;
+            e.y0 = 0; e.y1 = GRID_Y - 1;
+            if (depth - r <= nearPlane) continue; // Straddles the near plane, may cover the whole screen
+
+            glm::vec2 lo(1e30f), hi(-1e30f);
+            for (int c = 0; c < 8; ++c) {
+                glm::vec3 corner = e.center + glm::vec3(c & 1 ? r : -r, c & 2 ? r : -r, c & 4 ? r : -r);
+                glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                lo = glm::min(lo, ndc);
+                hi = glm::max(hi, ndc);
+            }
+            e.x0 = std::clamp((int)std::floor((lo.x * 0.5f + 0.5f) * GRID_X), 0, (int)GRID_X - 1);
+            e.x1 = std::clamp((int)std::floor((hi.x * 0.5f + 0.5f) * GRID_X), 0, (int)GRID_X - 1);
+            e.y0 = std::clamp((int)std::floor((lo.y * 0.5f + 0.5f) * GRID_Y), 0, (int)GRID_Y - 1);
+            e.y1 = std::clamp((int)std::floor((hi.y * 0.5f + 0.5f) * GRID_Y), 0, (int)GRID_Y - 1);
+            if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f) { e.z0 = 1; e.z1 = 0; }
+        }
+    });
+
+    // One slice per task, each only writes the lists of its own clusters
+    lists.resize(GRID_X * GRID_Y * GRID_Z);
+    ThreadPool::shared().parallelFor(GRID_Z, [&](size_t z) {
+        for (unsigned int y = 0; y < GRID_Y; ++y)
+            for (unsigned int x = 0; x < GRID_X; ++x)
+                lists[clusterIndex(x, y, z)].clear();
+
+        for (size_t i = 0; i < lights.size(); ++i) {
+            const Extent& e = extents[i];
+            if ((int)z < e.z0 || (int)z > e.z1) continue;
+            float r2 = lights[i].radius * lights[i].radius;
+            for (int y = e.y0; y <= e.y1; ++y) {
+                for (int x = e.x0; x <= e.x1; ++x) {
+                    unsigned int c = clusterIndex(x, y, z);
+                    glm::vec3 d = e.center - glm::clamp(e.center, boundsMin[c], boundsMax[c]);
+                    if (glm::dot(d, d) <= r2)
+                        lists[c].push_back((uint32_t)i);
+                }
+            }
+        }
+    });
+
+    ranges.resize(lists.size());
+    indices.clear();
+    size_t maxPerCluster = 0;
+    for (size_t c = 0; c < lists.size(); ++c) {
+        ranges[c] = glm::uvec2(indices.size(), lists[c].size());
+        indices.insert(indices.end(), lists[c].begin(), lists[c].end());
+        maxPerCluster = std::max(maxPerCluster, lists[c].size());
+    }
+    lastStats.indexCount = indices.size();
+    lastStats.maxPerCluster = maxPerCluster;
+    if (indices.empty()) indices.push_back(0); // Never bind an empty buffer
+
+    GPUHeader header;
+    header.params = glm::vec4(nearPlane, sliceScale, (float)viewportWidth / GRID_X, (float)viewportHeight / GRID_Y);
+    header.grid = glm::uvec4(GRID_X, GRID_Y, GRID_Z, 0);
+
+    // Orphaned every frame like the instance buffer
+    if (clusterBuffer == 0) {
+        glGenBuffers(1, &clusterBuffer);
+        glGenBuffers(1, &indexBuffer);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUHeader) + ranges.size() * sizeof(glm::uvec2), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GPUHeader), &header);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUHeader), ranges.size() * sizeof(glm::uvec2), ranges.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, clusterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, indexBuffer);
+
+    lastStats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+ClusterCheck LightClusters::validate(const std::vector<Light>& lights, const glm::mat4& view,
+                                     const glm::mat4& projection, float nearPlane, float farPlane) const {
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    float sliceScale = GRID_Z / std::log(farPlane / nearPlane);
+    std::vector<glm::vec3> centers(lights.size());
+    for (size_t i = 0; i < lights.size(); ++i)
+        centers[i] = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+
+    // Three samples per axis of every cluster, one slice per task
+    const float fractions[3] = {0.1f, 0.5f, 0.9f};
+    std::vector<ClusterCheck> perSlice(GRID_Z);
+    ThreadPool::shared().parallelFor(GRID_Z, [&](size_t z) {
+        ClusterCheck& check = perSlice[z];
+        for (unsigned int c = 0; c < GRID_X * GRID_Y; ++c) {
+            for (int sample = 0; sample < 27; ++sample) {
+                float fx = fractions[sample % 3], fy = fractions[sample / 3 % 3], fz = fractions[sample / 9];
+                glm::vec2 ndc((c % GRID_X + fx) / GRID_X * 2.0f - 1.0f, (c / GRID_X + fy) / GRID_Y * 2.0f - 1.0f);
+                float depth = nearPlane * std::pow(farPlane / nearPlane, (z + fz) / GRID_Z);
+                glm::vec4 p = inverseProjection * glm::vec4(ndc, -1.0f, 1.0f);
+                glm::vec3 dir = glm::vec3(p) / p.w;
+                glm::vec3 point = dir / -dir.z * depth;
+
+                // Same lookup as the fragment shader
+                int slice = std::clamp((int)std::floor(std::log(depth / nearPlane) * sliceScale), 0, (int)GRID_Z - 1);
+                int tileX = std::min((int)((ndc.x * 0.5f + 0.5f) * GRID_X), (int)GRID_X - 1);
+                int tileY = std::min((int)((ndc.y * 0.5f + 0.5f) * GRID_Y), (int)GRID_Y - 1);
+                const std::vector<uint32_t>& list = lists[clusterIndex(tileX, tileY, slice)];
+
+                check.points++;
+                for (size_t i = 0; i < lights.size(); ++i) {
+                    glm::vec3 d = point - centers[i];
+                    if (glm::dot(d, d) >= lights[i].radius * lights[i].radius) continue;
+                    check.litPairs++;
+                    if (std::find(list.begin(), list.end(), (uint32_t)i) == list.end()) check.missing++;
+                }
+            }
+        }
+    });
+
+    ClusterCheck total;
+    for (const ClusterCheck& check : perSlice) {
+        total.points += check.points;
+        total.litPairs += check.litPairs;
+        total.missing += check.missing;
+    }
+    return total;
+}
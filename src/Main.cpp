@@ -6,18 +6,38 @@
 
 #include "Shader.h"
 #include "Object.h"
+#include "MeshRegistry.h"
 #include "Camera.h"
 #include "Light.h"
+#include "LightBuffer.h"
+#include "LightClusters.h"
+#include "DeferredRenderer.h"
+#include "TextureCache.h"
+#include "AssetLoader.h"
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <random>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void benchmark_uniforms(const Shader& shader);
 
 #define WINDOW_TITLE "Title"
 int window_width = 1920;
 int window_height = 1080;
+// 16 byte quantized vertices (shaders/Compact.vs) instead of 52 byte float ones
+bool compact_vertices = true;
+// What meshes keep in RAM after their upload
+Residency mesh_residency = Residency::Discard;
+// Shade opaque objects through a G-buffer instead of in their own pass, toggled with G
+bool deferred_shading = false;
+// Time the per-draw uniform submission once the scene is loaded
+bool benchmark_uniform_submission = false;
+// Scatter this many small point lights through the scene, 4096 for the clustered lighting
+// benchmark, and print the average frame time every few seconds
+int benchmark_lights = 0;
 
 int main() {
     // Initialize and configure (glfw)
@@ -70,39 +90,37 @@ int main() {
             camera.nearPlane, camera.farPlane);
     glfwSetWindowUserPointer(window, &camera);
 
-    Shader Shader("shaders/Shader.vs", "shaders/Shader.fs");
+    Mesh::compactVertices = compact_vertices;
+    Mesh::defaultResidency = mesh_residency;
+    Mesh::viewportHeight = window_height;
+    const char* vertexShader = compact_vertices ? "shaders/Compact.vs" : "shaders/Shader.vs";
+    Shader Shader(vertexShader, "shaders/Shader.fs");
+    DeferredRenderer deferred(vertexShader);
     std::vector<Object*> sceneObjects;
     std::vector<Light> sceneLights;
+    LightBuffer lightBuffer;
+    LightClusters lightClusters;
 
-    auto light = [&Shader, &sceneLights, &sceneObjects](glm::vec3 Pos, glm::vec3 Color, float Intensity) {
-        sceneObjects.push_back(new Object("assets/Light.obj", &Shader));
+    // Everything streams in on worker threads, each file once however often it's placed
+    AssetLoader loader;
+    MeshRegistry& meshes = MeshRegistry::instance();
+
+    // Every light shares one mesh, its white material tinted to the light's color
+    auto light = [&](glm::vec3 Pos, glm::vec3 Color, float Intensity) {
+        sceneObjects.push_back(new Object(meshes.acquireAsync("assets/Light.obj", loader), &Shader));
         sceneObjects.back()->position = Pos;
         sceneObjects.back()->scale = glm::vec3(0.5f);
         sceneObjects.back()->useLighting = false;
+        sceneObjects.back()->tint = Color;
         sceneLights.push_back({Pos, Color, Intensity});
-
-        // Change the color of the light
-        size_t stride = 13;
-        size_t diffuseOffset = 9;
-        auto& verts = sceneObjects.back()->vertices;
-        for (size_t i = 0; i < verts.size(); i += stride) {
-            verts[i + diffuseOffset + 0] = Color.r;
-            verts[i + diffuseOffset + 1] = Color.g;
-            verts[i + diffuseOffset + 2] = Color.b;
-        }
-        // Re-upload the vertex data
-        glBindBuffer(GL_ARRAY_BUFFER, sceneObjects.back()->VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0,
-            sceneObjects.back()->vertices.size() * sizeof(float),
-            sceneObjects.back()->vertices.data());
     };
 
-    Object WorldAxis("assets/WorldAxis.obj", &Shader);
+    Object WorldAxis(meshes.acquireAsync("assets/WorldAxis.obj", loader), &Shader);
     WorldAxis.scale = glm::vec3(0.2f);
     WorldAxis.useLighting = false;
     sceneObjects.push_back(&WorldAxis);
 
-    Object Cube("assets/Cube.obj", &Shader);
+    Object Cube(meshes.acquireAsync("assets/Cube.obj", loader), &Shader);
     Cube.position = glm::vec3(-3.0f,  -0.5f,  -5.0f);
     Cube.rotation = glm::vec3(20.0f, 15.0f, 0.0f);
     Cube.scale = glm::vec3(0.5f);
@@ -110,36 +128,46 @@ int main() {
 
     light(glm::vec3(-1.5f,  0.0f,  -4.0f), glm::vec3(0.0f, 0.0f, 1.0f), 4.0f);
 
-    Object Monkey("assets/Monkey.obj", &Shader);
+    Object Monkey(meshes.acquireAsync("assets/Monkey.obj", loader), &Shader);
     Monkey.position = glm::vec3(5.0f,  0.0f,  -7.0f);
     Monkey.scale = glm::vec3(0.8f);
     sceneObjects.push_back(&Monkey);
 
     light(glm::vec3(5.0f, -1.0f, -6.0f), glm::vec3(0.0f, 1.0f, 0.0f), 1.0f);
 
-    Object AlphaCube("assets/AlphaCube.obj", &Shader);
+    Object AlphaCube(meshes.acquireAsync("assets/AlphaCube.obj", loader), &Shader);
     AlphaCube.position = glm::vec3(0.5f, 0.5f, -5.0f);
     AlphaCube.scale = glm::vec3(0.3f);
     sceneObjects.push_back(&AlphaCube);
 
-    Object Dragon("assets/Dragon.obj", &Shader);
+    Object Dragon(meshes.acquireAsync("assets/Dragon.obj", loader), &Shader);
     Dragon.position = glm::vec3(-1.0f, -2.0f, -10.0f);
     sceneObjects.push_back(&Dragon);
 
     light(glm::vec3(-1.0f, -1.0f, -9.0f), glm::vec3(1.0f, 1.0f, 1.0f), 1.0f);
 
+    // Only lighting, no meshes, so the benchmark measures the shading
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < benchmark_lights; ++i) {
+        glm::vec3 position(unit(random) * 20.0f - 10.0f, unit(random) * 6.0f - 3.0f, unit(random) * -20.0f);
+        glm::vec3 color(unit(random), unit(random), unit(random));
+        sceneLights.push_back({position, color, 0.3f, 1.5f});
+    }
+
     std::vector<Object*> opaqueObjects;
     std::vector<Object*> transparentObjects;
-    for (Object* obj : sceneObjects) {
-        if (obj->hasTransparency) {
-            transparentObjects.push_back(obj);
-        } else {
-            opaqueObjects.push_back(obj);
-        }
-    }
 
     double lastTime = glfwGetTime();
     double DeltaTime = 0.0;
+    bool firstFrame = true;
+    bool sceneLoaded = false;
+    bool deferredKeyHeld = false;
+    bool restoreKeyHeld = false;
+    int benchmarkFrames = 0;
+    bool benchmarkChecked = false;
+    double benchmarkStart = 0.0;
+    double benchmarkClusterMs = 0.0;
 
     while (!glfwWindowShouldClose(window)) {
         double currentTime = glfwGetTime();
@@ -205,7 +233,64 @@ int main() {
 
         camera.rotation = glm::normalize(camera.rotation);
 
+        // Switch between forward and deferred shading
+        bool deferredKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+        if (deferredKey && !deferredKeyHeld) {
+            deferred_shading = !deferred_shading;
+            std::cout << (deferred_shading ? "Deferred" : "Forward") << " shading" << std::endl;
+        }
+        deferredKeyHeld = deferredKey;
+
+        // Rebuild every mesh from what its residency kept, as after a lost context
+        bool restoreKey = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+        if (restoreKey && !restoreKeyHeld) {
+            size_t restored = meshes.restoreAll();
+            std::cout << "Restored " << restored << " of " << meshes.stats().meshCount << " meshes" << std::endl;
+        }
+        restoreKeyHeld = restoreKey;
+
         // Logic
+        // Upload whatever finished loading, without stalling the frame for too long
+        loader.update(4.0);
+        meshes.evictUnused();
+        TextureCache::instance().update(2.0);
+        if (!sceneLoaded && loader.idle() && TextureCache::instance().stats().pendingCount == 0) {
+            sceneLoaded = true;
+            std::cout << "Scene loaded after " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+
+            TextureStats textureStats = TextureCache::instance().stats();
+            std::cout << "Textures: " << textureStats.textureCount << " resident ("
+                      << textureStats.residentBytes / 1024 << " KB in " << textureStats.arrayCount << " arrays), "
+                      << textureStats.hits << " cache hits, " << textureStats.misses << " misses" << std::endl;
+
+            MeshStats meshStats = meshes.stats();
+            std::cout << "Meshes: " << meshStats.meshCount << " loaded for " << meshStats.hits + meshStats.misses
+                      << " objects" << std::endl;
+
+            MemoryUsage total;
+            for (const MeshMemory& entry : meshes.memoryReport()) {
+                std::cout << "  " << entry.path << " (" << entry.users << " objects): "
+                          << entry.usage.cpuBytes / 1024 << " KB CPU, " << entry.usage.gpuBytes / 1024 << " KB GPU" << std::endl;
+                total.cpuBytes += entry.usage.cpuBytes;
+                total.gpuBytes += entry.usage.gpuBytes;
+            }
+            std::cout << "Mesh memory: " << total.cpuBytes / 1024 << " KB CPU, " << total.gpuBytes / 1024 << " KB GPU" << std::endl;
+
+            if (benchmark_uniform_submission)
+                benchmark_uniforms(Shader);
+        }
+
+        // Objects only know whether they're transparent once loaded
+        opaqueObjects.clear();
+        transparentObjects.clear();
+        for (Object* obj : sceneObjects) {
+            if (!obj->loaded()) continue;
+            if (obj->mesh->hasTransparency) {
+                transparentObjects.push_back(obj);
+            } else {
+                opaqueObjects.push_back(obj);
+            }
+        }
 
         // Draw
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -214,10 +299,34 @@ int main() {
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 projection = camera.projectionMatrix;
 
-        // Draw opaque objects
-        for (Object* obj : opaqueObjects) {
-            obj->draw(view, projection, sceneLights);
+        // Camera matrices, lights and every texture of every object at once for every
+        // program, nothing of them is set per draw
+        camera.uploadFrameData((float)currentTime);
+        lightBuffer.update(sceneLights);
+        lightClusters.update(sceneLights, view, projection, camera.nearPlane, camera.farPlane,
+                             window_width, window_height);
+        TextureCache::instance().bind();
+
+        // Draw opaque objects, instancing the ones that share a mesh. Deferred they go into
+        // the G-buffer first and get shaded in one pass after.
+        if (deferred_shading)
+            deferred.beginGeometry(window_width, window_height);
+        const class Shader* opaqueShader = deferred_shading ? &deferred.geometryShader : nullptr;
+        std::stable_sort(opaqueObjects.begin(), opaqueObjects.end(), [](Object* a, Object* b) {
+            if (a->mesh != b->mesh) return a->mesh < b->mesh;
+            if (a->shader != b->shader) return a->shader < b->shader;
+            return a->useLighting < b->useLighting;
+        });
+        for (size_t i = 0; i < opaqueObjects.size();) {
+            size_t end = i + 1;
+            while (end < opaqueObjects.size() && opaqueObjects[end]->canInstanceWith(*opaqueObjects[i]))
+                end++;
+            Object::drawInstanced(opaqueObjects.data() + i, opaqueObjects.data() + end, view, projection,
+                                  opaqueShader);
+            i = end;
         }
+        if (deferred_shading)
+            deferred.shade(glm::vec3(1.0f), 0.1f);
 
         // Sort translucent objects back to front
         glm::vec3 camPos = camera.position;
@@ -235,7 +344,7 @@ int main() {
 
         // Draw translucent objects
         for (Object* obj : transparentObjects) {
-            obj->draw(view, projection, sceneLights);
+            obj->draw(view, projection);
         }
 
         glDepthMask(GL_TRUE);
@@ -243,11 +352,77 @@ int main() {
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (firstFrame) {
+            firstFrame = false;
+            std::cout << "First frame after " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+        }
+
+        if (benchmark_lights > 0 && sceneLoaded) {
+            if (!benchmarkChecked) {
+                // Once, against a brute force search, before timing anything
+                ClusterCheck check = lightClusters.validate(sceneLights, view, projection, camera.nearPlane,
+                                                            camera.farPlane);
+                std::cout << "Cluster check: " << check.points << " points, " << check.litPairs
+                          << " lit by a light, " << check.missing << " of those missing from their cluster"
+                          << std::endl;
+                benchmarkChecked = true;
+            }
+            if (benchmarkFrames == 0) benchmarkStart = glfwGetTime();
+            benchmarkFrames++;
+            benchmarkClusterMs += lightClusters.stats().buildMs;
+            double elapsed = glfwGetTime() - benchmarkStart;
+            if (elapsed >= 5.0) {
+                const ClusterStats& clusterStats = lightClusters.stats();
+                std::cout << sceneLights.size() << " lights: " << elapsed * 1000.0 / benchmarkFrames
+                          << " ms per frame, clusters built in " << benchmarkClusterMs / benchmarkFrames << " ms, "
+                          << clusterStats.indexCount << " light references, at most " << clusterStats.maxPerCluster
+                          << " per cluster" << std::endl;
+                benchmarkFrames = 0;
+                benchmarkClusterMs = 0.0;
+            }
+        }
     }
+    meshes.releaseAll();
+    deferred.release();
     glfwTerminate();
     return 0;
 }
 
+// The uniforms Object::drawInstanced sets per draw, looked up by name through the driver on
+// every set like the setters used to, then through the Shader's location cache
+void benchmark_uniforms(const Shader& shader) {
+    using Clock = std::chrono::steady_clock;
+    const int draws = 10000;
+    glm::vec3 boundsMin(-1.0f), boundsExtent(2.0f), ambientColor(1.0f);
+    shader.use();
+
+    glFinish();
+    auto start = Clock::now();
+    for (int draw = 0; draw < draws; ++draw) {
+        glUniform3fv(glGetUniformLocation(shader.ID, "boundsMin"), 1, &boundsMin[0]);
+        glUniform3fv(glGetUniformLocation(shader.ID, "boundsExtent"), 1, &boundsExtent[0]);
+        glUniform1i(glGetUniformLocation(shader.ID, "useLighting"), 1);
+        glUniform3fv(glGetUniformLocation(shader.ID, "ambientLightColor"), 1, &ambientColor[0]);
+        glUniform1f(glGetUniformLocation(shader.ID, "ambientLight"), 0.1f);
+    }
+    glFinish();
+    double uncachedNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / draws;
+
+    start = Clock::now();
+    for (int draw = 0; draw < draws; ++draw) {
+        shader.setVec3("boundsMin", boundsMin);
+        shader.setVec3("boundsExtent", boundsExtent);
+        shader.setBool("useLighting", true);
+        shader.setVec3("ambientLightColor", ambientColor);
+        shader.setFloat("ambientLight", 0.1f);
+    }
+    glFinish();
+    double cachedNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / draws;
+
+    std::cout << "Uniform submission: " << uncachedNs << " ns per draw by name, " << cachedNs << " ns cached" << std::endl;
+}
+
 // Callback for whenever the window size changed (by OS or user resize)
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     if (height == 0) height = 1;
@@ -260,6 +435,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 
     window_width = width;
     window_height = height;
+    Mesh::viewportHeight = height;
 }
 
 // Callback for whenever the mouse is moved
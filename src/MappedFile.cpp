@@ -0,0 +1,67 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return;
+    fileHandle = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) return;
+    length = (size_t)fileSize.QuadPart;
+    opened = true;
+
+    // Empty files can't be mapped, but are still valid files
+    if (length == 0) return;
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) { opened = false; return; }
+    mappingHandle = mapping;
+
+    begin = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!begin) opened = false;
+}
+
+MappedFile::~MappedFile() {
+    if (begin) UnmapViewOfFile(begin);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) return;
+    length = (size_t)st.st_size;
+    opened = true;
+
+    // Empty files can't be mapped, but are still valid files
+    if (length == 0) return;
+
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) { opened = false; return; }
+
+    // The whole file is scanned front to back
+    madvise(mapped, length, MADV_SEQUENTIAL);
+    begin = static_cast<const char*>(mapped);
+}
+
+MappedFile::~MappedFile() {
+    if (begin) munmap(const_cast<char*>(begin), length);
+    if (fd >= 0) close(fd);
+}
+#endif
@@ -1,48 +1,11 @@
 #include "Material.h"
-#include "STB/stb_image.h"
-#include <glad/gl.h>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <filesystem>
+#include <mutex>
 
-unsigned int loadImage(const char* path) {
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
-
-    if (!data) {
-        std::cout << "Failed to load texture: " << path << std::endl;
-        return 0;
-    }
-
-    GLenum format, internalFormat;
-    if (nrChannels == 1) format = internalFormat = GL_RED;
-    else if (nrChannels == 3) { format = GL_RGB; internalFormat = GL_SRGB; }
-    else if (nrChannels == 4) { format = GL_RGBA; internalFormat = GL_SRGB_ALPHA; }
-    else {
-        std::cout << "Unsupported number of channels: " << nrChannels << std::endl;
-        stbi_image_free(data);
-        return 0;
-    }
-
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(data);
-    return texture;
-}
-
-bool Material::loadMTL(const std::string& path, const std::string &materialName) {
+bool MaterialLibrary::parse(const std::string& path) {
     std::ifstream in(path);
     if (!in.is_open()) {
         std::cerr << "Failed to open MTL file: " << path << "\n";
@@ -50,7 +13,7 @@ bool Material::loadMTL(const std::string& path, const std::string &materialName)
     }
 
     std::string line;
-    bool skipping = false;
+    Material* current = nullptr;
     std::filesystem::path directory = std::filesystem::path(path).parent_path();
 
     while (std::getline(in, line)) {
@@ -61,29 +24,57 @@ bool Material::loadMTL(const std::string& path, const std::string &materialName)
         if (type == "newmtl") {
             std::string name;
             ss >> name;
-            skipping = (name != materialName);
-            if (!skipping) this->name = name;
+            current = &materials[name];
+            current->name = name;
         }
-        else if (skipping) {
+        else if (!current) {
             continue;
         }
         else if (type == "Kd") {
-            ss >> diffuseColor.x >> diffuseColor.y >> diffuseColor.z;
+            ss >> current->diffuseColor.x >> current->diffuseColor.y >> current->diffuseColor.z;
         }
         else if (type == "d") {
-            ss >> opacity;
+            ss >> current->opacity;
         }
         else if (type == "Tr") {
             float transparency;
             ss >> transparency;
-            opacity = 1.0f - transparency;
+            current->opacity = 1.0f - transparency;
         }
         else if (type == "map_Kd") {
             std::string texFile;
             ss >> texFile;
-            diffuseTexture = loadImage((directory / texFile).string().c_str());
-            if (diffuseTexture == 0) std::cout << "Failed to load: " << path << std::endl;
+            // Textures are only loaded once a mesh using them is uploaded
+            std::filesystem::path texPath = directory / texFile;
+            if (std::filesystem::exists(texPath))
+                current->diffuseTexturePath = texPath.string();
+            else
+                std::cout << "Failed to load texture: " << texPath.string() << std::endl;
         }
     }
     return true;
-}
\ No newline at end of file
+}
+
+const Material* MaterialLibrary::find(const std::string& name) const {
+    auto it = materials.find(name);
+    return it != materials.end() ? &it->second : nullptr;
+}
+
+std::shared_ptr<const MaterialLibrary> MaterialLibrary::load(const std::string& path) {
+    static std::mutex cacheMutex;
+    static std::unordered_map<std::string, std::shared_ptr<const MaterialLibrary>> cache;
+
+    std::error_code ec;
+    std::string key = std::filesystem::weakly_canonical(path, ec).string();
+    if (ec) key = path;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache.find(key);
+    if (it != cache.end()) return it->second;
+
+    // Failed loads are cached as empty libraries so they aren't retried for every usemtl
+    auto library = std::make_shared<MaterialLibrary>();
+    library->parse(path);
+    cache.emplace(key, library);
+    return library;
+}
@@ -0,0 +1,325 @@
+#include "Mesh.h"
+#include "TextureCache.h"
+#include "MeshCodec.h"
+#include <cstddef>
+#include <algorithm>
+#include <cmath>
+
+Frustum::Frustum(const glm::mat4& clip) {
+    for (int i = 0; i < 3; ++i) {
+        glm::vec4 row(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+        glm::vec4 w(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+        planes[i * 2] = w + row;
+        planes[i * 2 + 1] = w - row;
+    }
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::intersects(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : planes)
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+    return true;
+}
+
+bool Frustum::intersects(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+    // Outside a plane when even the corner furthest along its normal is behind it
+    for (const glm::vec4& plane : planes) {
+        glm::vec3 normal(plane);
+        glm::vec3 corner = glm::mix(boxMin, boxMax, glm::greaterThan(normal, glm::vec3(0.0f)));
+        if (glm::dot(normal, corner) + plane.w < 0.0f) return false;
+    }
+    return true;
+}
+
+void Mesh::upload(MeshData&& mesh) {
+    // Quantize while the mesh still has its bounds
+    compact = compactVertices;
+    std::vector<CompactVertex> compactVerts;
+    if (compact)
+        mesh.compact(compactVerts, materials);
+
+    submeshes = std::move(mesh.submeshes);
+    meshlets = std::move(mesh.meshlets);
+    hasTransparency = mesh.hasTransparency;
+    boundsMin = mesh.boundsMin;
+    boundsMax = mesh.boundsMax;
+    vertexCount = mesh.vertexCount();
+    indexCount = mesh.indices.size();
+    if (submeshes.empty()) {
+        MeshData::Submesh whole;
+        whole.boundsMin = boundsMin;
+        whole.boundsMax = boundsMax;
+        whole.lods.push_back({0, (unsigned int)indexCount, 0.0f});
+        whole.meshletCount = meshlets.size();
+        submeshes.push_back(whole);
+    }
+    // Textures stream in behind a placeholder, see TextureCache::update
+    for (const auto& texPath : mesh.texturePaths)
+        textures.push_back(TextureCache::instance().acquireAsync(texPath));
+
+    // Texture IDs become cache handles, the shaders resolve those without any binding per mesh
+    if (compact) {
+        for (CompactMaterial& material : materials)
+            if (material.textureIndex >= 0) material.textureIndex = textures[material.textureIndex];
+    } else {
+        for (size_t i = 8; i < mesh.vertices.size(); i += MeshData::VERTEX_STRIDE)
+            if (mesh.vertices[i] >= 0.0f) mesh.vertices[i] = (float)textures[(size_t)mesh.vertices[i]];
+    }
+
+    const void* vertexData = compact ? (const void*)compactVerts.data() : (const void*)mesh.vertices.data();
+    createBuffers(vertexData, mesh.indices);
+
+    // Whatever restore() needs, the rest is freed with mesh
+    switch (residency) {
+    case Residency::Discard:
+        break;
+    case Residency::Keep:
+        if (compact) {
+            compactVertexData = std::move(compactVerts);
+        } else {
+            vertices = std::move(mesh.vertices);
+        }
+        indices = std::move(mesh.indices);
+        break;
+    case Residency::Compressed:
+        packedVertices = MeshCodec::encodeVertices(vertexData, vertexCount, vertexSize());
+        packedIndices = MeshCodec::encodeIndices(mesh.indices);
+        packedVertices.shrink_to_fit();
+        packedIndices.shrink_to_fit();
+        break;
+    }
+
+    loaded = true;
+}
+
+bool Mesh::restore() {
+    if (!loaded) return false;
+
+    switch (residency) {
+    case Residency::Keep:
+        deleteBuffers();
+        createBuffers(compact ? (const void*)compactVertexData.data() : (const void*)vertices.data(), indices);
+        return true;
+    case Residency::Compressed: {
+        std::vector<unsigned char> vertexData(vertexCount * vertexSize());
+        std::vector<unsigned int> unpackedIndices;
+        if (!MeshCodec::decodeVertices(packedVertices, vertexData.data(), vertexCount, vertexSize()) ||
+            !MeshCodec::decodeIndices(packedIndices, unpackedIndices, indexCount))
+            return false;
+        deleteBuffers();
+        createBuffers(vertexData.data(), unpackedIndices);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void Mesh::release() {
+    loaded = false;
+    deleteBuffers();
+
+    for (unsigned int handle : textures)
+        TextureCache::instance().release(handle);
+    textures.clear();
+}
+
+size_t Mesh::vertexSize() const {
+    return compact ? sizeof(CompactVertex) : MeshData::VERTEX_STRIDE * sizeof(float);
+}
+
+MemoryUsage Mesh::memoryUsage() const {
+    MemoryUsage usage;
+    usage.gpuBytes = gpuBytes;
+    usage.cpuBytes = vertices.capacity() * sizeof(float) +
+                     compactVertexData.capacity() * sizeof(CompactVertex) +
+                     indices.capacity() * sizeof(unsigned int) +
+                     packedVertices.capacity() + packedIndices.capacity() +
+                     meshlets.capacity() * sizeof(MeshData::Meshlet) +
+                     materials.capacity() * sizeof(CompactMaterial) +
+                     textures.capacity() * sizeof(unsigned int);
+    for (const MeshData::Submesh& submesh : submeshes)
+        usage.cpuBytes += sizeof(submesh) + submesh.lods.capacity() * sizeof(MeshData::LOD) +
+                          submesh.name.capacity() + submesh.material.capacity();
+    return usage;
+}
+
+void Mesh::createBuffers(const void* vertexData, const std::vector<unsigned int>& indexData) {
+    // Generate VAO and VBO
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize(), vertexData, GL_STATIC_DRAW);
+    gpuBytes = vertexCount * vertexSize();
+
+    // Use 16-bit indices whenever every vertex can be addressed with them
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    if (vertexCount <= 0xFFFF) {
+        std::vector<unsigned short> shortIndices(indexData.begin(), indexData.end());
+        indexType = GL_UNSIGNED_SHORT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+        gpuBytes += shortIndices.size() * sizeof(unsigned short);
+    } else {
+        indexType = GL_UNSIGNED_INT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size() * sizeof(unsigned int), indexData.data(), GL_STATIC_DRAW);
+        gpuBytes += indexData.size() * sizeof(unsigned int);
+    }
+
+    if (compact) {
+        setupCompactLayout();
+        gpuBytes += materials.size() * sizeof(CompactMaterial);
+    } else {
+        setupFloatLayout();
+    }
+
+    // Unbind the VAO first so it keeps its element buffer binding
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Mesh::deleteBuffers() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &materialBuffer);
+    VAO = VBO = EBO = materialBuffer = 0;
+    gpuBytes = 0;
+}
+
+void Mesh::setupFloatLayout() {
+    // Position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    // Normal
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)(3*sizeof(float)));
+    glEnableVertexAttribArray(1);
+    // Texture Coord
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)(6*sizeof(float)));
+    glEnableVertexAttribArray(2);
+    // Texture ID
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)(8*sizeof(float)));
+    glEnableVertexAttribArray(3);
+    // Diffuse Color
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)(9*sizeof(float)));
+    glEnableVertexAttribArray(4);
+    // Opacity
+    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)(12*sizeof(float)));
+    glEnableVertexAttribArray(5);
+}
+
+void Mesh::setupCompactLayout() {
+    glGenBuffers(1, &materialBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(CompactMaterial), materials.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    GLsizei stride = sizeof(CompactVertex);
+    // Position
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, position));
+    glEnableVertexAttribArray(0);
+    // Material index
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_SHORT, stride, (void*)offsetof(CompactVertex, material));
+    glEnableVertexAttribArray(1);
+    // Normal
+    glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, normal));
+    glEnableVertexAttribArray(2);
+    // Texture Coord
+    glVertexAttribPointer(3, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(CompactVertex, texcoord));
+    glEnableVertexAttribArray(3);
+}
+
+size_t Mesh::selectLOD(const MeshData::Submesh& submesh, const glm::mat4& model, const glm::mat4& view,
+                       const glm::mat4& projection) const {
+    const std::vector<MeshData::LOD>& lods = submesh.lods;
+    if (lods.size() < 2) return 0;
+
+    // Distance to the nearest point of the bounding sphere, in view space
+    float maxScale = std::max(glm::length(glm::vec3(model[0])),
+                              std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    glm::vec3 center = glm::vec3(view * model * glm::vec4((submesh.boundsMin + submesh.boundsMax) * 0.5f, 1.0f));
+    float radius = glm::length(submesh.boundsMax - submesh.boundsMin) * 0.5f * maxScale;
+    float distance = glm::length(center) - radius;
+    if (distance <= 0.0f) return 0;
+
+    // Pixels covered by one world unit at that distance
+    float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f / distance;
+
+    size_t lod = 0;
+    while (lod + 1 < lods.size() && lods[lod + 1].error * maxScale * pixelsPerUnit <= lodPixelError)
+        lod++;
+    return lod;
+}
+
+void Mesh::addRange(unsigned int offset, unsigned int count, std::vector<GLsizei>& counts,
+                    std::vector<const void*>& offsets) const {
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    if (!counts.empty() && (size_t)offsets.back() / indexSize + counts.back() == offset) {
+        counts.back() += count;
+    } else {
+        counts.push_back(count);
+        offsets.push_back((const void*)(offset * indexSize));
+    }
+}
+
+void Mesh::collectDrawRanges(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+                             std::vector<GLsizei>& counts, std::vector<const void*>& offsets) const {
+    counts.clear();
+    offsets.clear();
+
+    // Everything in model space: frustum planes from the full transform and the eye
+    // moved into the model, which holds for any affine model matrix
+    Frustum frustum(projection * view * model);
+    glm::vec3 eye = glm::vec3(glm::inverse(view * model)[3]);
+
+    for (const MeshData::Submesh& submesh : submeshes) {
+        if (!frustum.intersects(submesh.boundsMin, submesh.boundsMax)) continue;
+
+        size_t lodIndex = selectLOD(submesh, model, view, projection);
+        if (lodIndex != 0 || submesh.meshletCount == 0) {
+            // The coarser LODs are cheap enough whole
+            const MeshData::LOD& lod = submesh.lods[lodIndex];
+            addRange(lod.indexOffset, lod.indexCount, counts, offsets);
+            continue;
+        }
+
+        for (size_t m = submesh.meshletOffset; m < submesh.meshletOffset + submesh.meshletCount; ++m) {
+            const MeshData::Meshlet& meshlet = meshlets[m];
+            if (!frustum.intersects(meshlet.center, meshlet.radius)) continue;
+
+            glm::vec3 toCenter = meshlet.center - eye;
+            if (glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius)
+                continue;
+
+            addRange(meshlet.indexOffset, meshlet.indexCount, counts, offsets);
+        }
+    }
+}
+
+void Mesh::collectInstancedRanges(const std::vector<glm::mat4>& models, const glm::mat4& view,
+                                  const glm::mat4& projection, std::vector<GLsizei>& counts,
+                                  std::vector<const void*>& offsets) const {
+    counts.clear();
+    offsets.clear();
+
+    // Reused across calls, drawing only happens on the GL thread
+    static std::vector<size_t> lodIndex;
+    lodIndex.assign(submeshes.size(), ~(size_t)0);
+    for (const glm::mat4& model : models) {
+        Frustum frustum(projection * view * model);
+        for (size_t s = 0; s < submeshes.size(); ++s) {
+            if (lodIndex[s] == 0 || !frustum.intersects(submeshes[s].boundsMin, submeshes[s].boundsMax)) continue;
+            lodIndex[s] = std::min(lodIndex[s], selectLOD(submeshes[s], model, view, projection));
+        }
+    }
+
+    for (size_t s = 0; s < submeshes.size(); ++s) {
+        if (lodIndex[s] == ~(size_t)0) continue;
+        const MeshData::LOD& lod = submeshes[s].lods[lodIndex[s]];
+        addRange(lod.indexOffset, lod.indexCount, counts, offsets);
+    }
+}
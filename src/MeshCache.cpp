@@ -0,0 +1,293 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <functional>
+
+static constexpr char MAGIC[4] = {'M', 'S', 'H', 'C'};
+
+struct FileStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+};
+
+static bool stampFile(const std::string& path, FileStamp& stamp) {
+    std::error_code ec;
+    stamp.size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    stamp.mtime = time.time_since_epoch().count();
+    return true;
+}
+
+// FNV-1a, only used when the timestamp of the source changed
+static uint64_t hashFile(const std::string& path) {
+    MappedFile file(path);
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(file.data());
+    for (size_t i = 0; i < file.size(); ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Append-only writer for the cache blob
+class BlobWriter {
+public:
+    std::vector<char> bytes;
+
+    template<typename T>
+    void put(const T& value) { putBytes(&value, sizeof(T)); }
+
+    void putBytes(const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        bytes.insert(bytes.end(), p, p + size);
+    }
+
+    void putString(const std::string& s) {
+        put<uint32_t>(s.size());
+        putBytes(s.data(), s.size());
+    }
+};
+
+// Bounds checked reader over the mapped cache blob
+class BlobReader {
+public:
+    BlobReader(const char* data, size_t size) : cur(data), end(data + size) {}
+
+    template<typename T>
+    bool get(T& value) { return getBytes(&value, sizeof(T)); }
+
+    bool getBytes(void* out, size_t size) {
+        if ((size_t)(end - cur) < size) return false;
+        std::memcpy(out, cur, size);
+        cur += size;
+        return true;
+    }
+
+    size_t remaining() const { return end - cur; }
+
+    // Whether count elements of elementSize bytes are left, checked before sizing anything by count
+    bool holds(uint64_t count, size_t elementSize) const { return count <= remaining() / elementSize; }
+
+    bool getString(std::string& s) {
+        uint32_t size;
+        if (!get(size) || (size_t)(end - cur) < size) return false;
+        s.assign(cur, size);
+        cur += size;
+        return true;
+    }
+
+private:
+    const char* cur;
+    const char* end;
+};
+
+// Whether [offset, offset + count) lies within size elements, without wrapping
+static bool inRange(uint64_t offset, uint64_t count, size_t size) {
+    return offset <= size && count <= size - offset;
+}
+
+// Serialized sizes of a LOD, and of a submesh with empty strings and no LODs
+static constexpr size_t LOD_BYTES = 2 * sizeof(uint32_t) + sizeof(float);
+static constexpr size_t MIN_SUBMESH_BYTES = 2 * sizeof(uint32_t) + 2 * sizeof(glm::vec3) + 3 * sizeof(uint32_t);
+
+// Offset of the source's mtime in the header, after the magic, version and size
+static constexpr std::streamoff SOURCE_MTIME_OFFSET = 4 + sizeof(uint32_t) + sizeof(uint64_t);
+
+static void restamp(const std::string& sourcePath, const FileStamp& stamp) {
+    std::fstream file(MeshCache::cachePath(sourcePath), std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) return;
+    file.seekp(SOURCE_MTIME_OFFSET);
+    file.write(reinterpret_cast<const char*>(&stamp.mtime), sizeof(stamp.mtime));
+}
+
+std::string MeshCache::cachePath(const std::string& sourcePath) {
+    return sourcePath + ".mcache";
+}
+
+// Parse and validate an entry. Sets touched when only the source's mtime is stale.
+static bool readEntry(const std::string& sourcePath, MeshData& mesh, FileStamp& current, bool& touched) {
+    MappedFile file(MeshCache::cachePath(sourcePath));
+    if (!file.isOpen()) return false;
+
+    BlobReader in(file.data(), file.size());
+
+    char magic[4];
+    uint32_t version;
+    if (!in.getBytes(magic, 4) || std::memcmp(magic, MAGIC, 4) != 0) return false;
+    if (!in.get(version) || version != MeshCache::VERSION) return false;
+
+    // Source file: a matching timestamp is enough, otherwise compare the content
+    FileStamp cached;
+    uint64_t cachedHash;
+    if (!in.get(cached.size) || !in.get(cached.mtime) || !in.get(cachedHash)) return false;
+    if (!stampFile(sourcePath, current)) return false;
+    if (current.size != cached.size) return false;
+    touched = current.mtime != cached.mtime;
+    if (touched && hashFile(sourcePath) != cachedHash) return false;
+
+    // Material libraries baked into the vertex colors. One that was missing at save time
+    // stays valid for as long as it's still missing.
+    uint32_t dependencyCount;
+    if (!in.get(dependencyCount)) return false;
+    for (uint32_t i = 0; i < dependencyCount; ++i) {
+        std::string path;
+        uint8_t existed;
+        FileStamp stamp, now;
+        if (!in.getString(path) || !in.get(existed) || !in.get(stamp.size) || !in.get(stamp.mtime)) return false;
+        bool exists = stampFile(path, now);
+        if (exists != (existed != 0)) return false;
+        if (exists && (now.size != stamp.size || now.mtime != stamp.mtime)) return false;
+    }
+
+    uint8_t hasTransparency;
+    if (!in.get(hasTransparency)) return false;
+    if (!in.get(mesh.boundsMin) || !in.get(mesh.boundsMax)) return false;
+
+    uint32_t textureCount;
+    if (!in.get(textureCount) || !in.holds(textureCount, sizeof(uint32_t))) return false;
+    mesh.texturePaths.resize(textureCount);
+    for (auto& path : mesh.texturePaths)
+        if (!in.getString(path)) return false;
+
+    // Counts of a truncated or corrupt file must not size anything
+    uint64_t vertexFloats, indexCount;
+    if (!in.get(vertexFloats) || !in.get(indexCount)) return false;
+    if (vertexFloats % MeshData::VERTEX_STRIDE != 0 || !in.holds(vertexFloats, sizeof(float))) return false;
+    mesh.vertices.resize(vertexFloats);
+    if (!in.getBytes(mesh.vertices.data(), vertexFloats * sizeof(float))) return false;
+    if (!in.holds(indexCount, sizeof(unsigned int))) return false;
+    mesh.indices.resize(indexCount);
+    if (!in.getBytes(mesh.indices.data(), indexCount * sizeof(unsigned int))) return false;
+
+    size_t vertexCount = mesh.vertexCount();
+    for (unsigned int index : mesh.indices)
+        if (index >= vertexCount) return false;
+
+    uint32_t submeshCount;
+    if (!in.get(submeshCount) || !in.holds(submeshCount, MIN_SUBMESH_BYTES)) return false;
+    mesh.submeshes.resize(submeshCount);
+    for (auto& submesh : mesh.submeshes) {
+        uint32_t lodCount;
+        if (!in.getString(submesh.name) || !in.getString(submesh.material)) return false;
+        if (!in.get(submesh.boundsMin) || !in.get(submesh.boundsMax)) return false;
+        if (!in.get(submesh.meshletOffset) || !in.get(submesh.meshletCount)) return false;
+        if (!in.get(lodCount) || !in.holds(lodCount, LOD_BYTES)) return false;
+        submesh.lods.resize(lodCount);
+        for (auto& lod : submesh.lods) {
+            if (!in.get(lod.indexOffset) || !in.get(lod.indexCount) || !in.get(lod.error)) return false;
+            if (!inRange(lod.indexOffset, lod.indexCount, mesh.indices.size())) return false;
+        }
+    }
+
+    uint32_t meshletCount;
+    if (!in.get(meshletCount) || !in.holds(meshletCount, sizeof(MeshData::Meshlet))) return false;
+    mesh.meshlets.resize(meshletCount);
+    if (!in.getBytes(mesh.meshlets.data(), meshletCount * sizeof(MeshData::Meshlet))) return false;
+    for (const auto& meshlet : mesh.meshlets)
+        if (!inRange(meshlet.indexOffset, meshlet.indexCount, mesh.indices.size())) return false;
+    for (const auto& submesh : mesh.submeshes)
+        if (!inRange(submesh.meshletOffset, submesh.meshletCount, mesh.meshlets.size())) return false;
+
+    mesh.hasTransparency = hasTransparency != 0;
+    return true;
+}
+
+bool MeshCache::load(const std::string& sourcePath, MeshData& mesh) {
+    FileStamp current;
+    bool touched = false;
+    if (!readEntry(sourcePath, mesh, current, touched)) return false;
+
+    // The source was only touched, stamp it again once unmapped so the next load skips the hash
+    if (touched) restamp(sourcePath, current);
+    return true;
+}
+
+bool MeshCache::save(const std::string& sourcePath, const MeshData& mesh,
+                     const std::vector<std::string>& dependencies) {
+    FileStamp source;
+    if (!stampFile(sourcePath, source)) return false;
+
+    BlobWriter out;
+    out.putBytes(MAGIC, 4);
+    out.put<uint32_t>(VERSION);
+
+    out.put(source.size);
+    out.put(source.mtime);
+    out.put(hashFile(sourcePath));
+
+    out.put<uint32_t>(dependencies.size());
+    for (const auto& path : dependencies) {
+        FileStamp stamp;
+        bool exists = stampFile(path, stamp);
+        out.putString(path);
+        out.put<uint8_t>(exists);
+        out.put(stamp.size);
+        out.put(stamp.mtime);
+    }
+
+    out.put<uint8_t>(mesh.hasTransparency);
+    out.put(mesh.boundsMin);
+    out.put(mesh.boundsMax);
+
+    out.put<uint32_t>(mesh.texturePaths.size());
+    for (const auto& path : mesh.texturePaths)
+        out.putString(path);
+
+    out.put<uint64_t>(mesh.vertices.size());
+    out.put<uint64_t>(mesh.indices.size());
+    out.putBytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+    out.putBytes(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+
+    out.put<uint32_t>(mesh.submeshes.size());
+    for (const auto& submesh : mesh.submeshes) {
+        out.putString(submesh.name);
+        out.putString(submesh.material);
+        out.put(submesh.boundsMin);
+        out.put(submesh.boundsMax);
+        out.put(submesh.meshletOffset);
+        out.put(submesh.meshletCount);
+        out.put<uint32_t>(submesh.lods.size());
+        for (const auto& lod : submesh.lods) {
+            out.put(lod.indexOffset);
+            out.put(lod.indexCount);
+            out.put(lod.error);
+        }
+    }
+
+    out.put<uint32_t>(mesh.meshlets.size());
+    out.putBytes(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(MeshData::Meshlet));
+
+    // Write to a temporary file first so a crash never leaves a half written entry.
+    // The name is per thread since the same asset may be loaded by two jobs at once.
+    std::string path = cachePath(sourcePath);
+    std::string tempPath = path + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write mesh cache: " << path << "\n";
+            return false;
+        }
+        file.write(out.bytes.data(), out.bytes.size());
+        if (!file) {
+            std::cerr << "Failed to write mesh cache: " << path << "\n";
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        std::cerr << "Failed to write mesh cache: " << path << "\n";
+        return false;
+    }
+    return true;
+}
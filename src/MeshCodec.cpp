@@ -0,0 +1,124 @@
+#include "MeshCodec.h"
+#include <algorithm>
+
+static constexpr size_t GROUP_SIZE = 16;
+
+static uint8_t zigzag8(uint8_t delta) {
+    int8_t s = (int8_t)delta;
+    return (uint8_t)((s << 1) ^ (s >> 7));
+}
+
+static uint8_t unzigzag8(uint8_t z) {
+    return (uint8_t)((z >> 1) ^ -(z & 1));
+}
+
+std::vector<uint8_t> MeshCodec::encodeVertices(const void* vertices, size_t vertexCount, size_t stride) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+    std::vector<uint8_t> out;
+    out.reserve(vertexCount * stride / 2);
+
+    uint8_t values[GROUP_SIZE];
+    for (size_t k = 0; k < stride; ++k) {
+        uint8_t previous = 0;
+        for (size_t first = 0; first < vertexCount; first += GROUP_SIZE) {
+            size_t count = std::min(GROUP_SIZE, vertexCount - first);
+            uint8_t combined = 0;
+            for (size_t i = 0; i < count; ++i) {
+                uint8_t value = bytes[(first + i) * stride + k];
+                values[i] = zigzag8(value - previous);
+                previous = value;
+                combined |= values[i];
+            }
+
+            unsigned int bits = combined == 0 ? 0 : combined < 2 ? 1 : combined < 4 ? 2 : combined < 16 ? 4 : 8;
+            out.push_back(bits);
+            if (bits == 0) continue;
+
+            // LSB first, a group never straddles a byte boundary at the end
+            unsigned int accumulator = 0, filled = 0;
+            for (size_t i = 0; i < count; ++i) {
+                accumulator |= values[i] << filled;
+                filled += bits;
+                if (filled >= 8) {
+                    out.push_back(accumulator & 0xFF);
+                    accumulator >>= 8;
+                    filled -= 8;
+                }
+            }
+            if (filled > 0) out.push_back(accumulator & 0xFF);
+        }
+    }
+    return out;
+}
+
+bool MeshCodec::decodeVertices(const std::vector<uint8_t>& encoded, void* vertices, size_t vertexCount, size_t stride) {
+    uint8_t* bytes = static_cast<uint8_t*>(vertices);
+    size_t cursor = 0;
+
+    for (size_t k = 0; k < stride; ++k) {
+        uint8_t previous = 0;
+        for (size_t first = 0; first < vertexCount; first += GROUP_SIZE) {
+            size_t count = std::min(GROUP_SIZE, vertexCount - first);
+            if (cursor >= encoded.size()) return false;
+            unsigned int bits = encoded[cursor++];
+            if (bits != 0 && bits != 1 && bits != 2 && bits != 4 && bits != 8) return false;
+
+            size_t packedSize = (count * bits + 7) / 8;
+            if (encoded.size() - cursor < packedSize) return false;
+
+            unsigned int accumulator = 0, filled = 0;
+            unsigned int mask = (1u << bits) - 1;
+            for (size_t i = 0; i < count; ++i) {
+                uint8_t z = 0;
+                if (bits != 0) {
+                    if (filled < bits) {
+                        accumulator |= encoded[cursor++] << filled;
+                        filled += 8;
+                    }
+                    z = accumulator & mask;
+                    accumulator >>= bits;
+                    filled -= bits;
+                }
+                previous += unzigzag8(z);
+                bytes[(first + i) * stride + k] = previous;
+            }
+        }
+    }
+    return cursor == encoded.size();
+}
+
+std::vector<uint8_t> MeshCodec::encodeIndices(const std::vector<unsigned int>& indices) {
+    std::vector<uint8_t> out;
+    out.reserve(indices.size() * 2);
+
+    unsigned int previous = 0;
+    for (unsigned int index : indices) {
+        int32_t delta = (int32_t)(index - previous);
+        uint32_t z = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        previous = index;
+        while (z >= 0x80) {
+            out.push_back((z & 0x7F) | 0x80);
+            z >>= 7;
+        }
+        out.push_back(z);
+    }
+    return out;
+}
+
+bool MeshCodec::decodeIndices(const std::vector<uint8_t>& encoded, std::vector<unsigned int>& indices, size_t indexCount) {
+    indices.resize(indexCount);
+    size_t cursor = 0;
+    unsigned int previous = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t z = 0;
+        for (unsigned int shift = 0;; shift += 7) {
+            if (cursor >= encoded.size() || shift > 28) return false;
+            uint8_t byte = encoded[cursor++];
+            z |= (uint32_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        previous += (unsigned int)((z >> 1) ^ -(z & 1));
+        indices[i] = previous;
+    }
+    return cursor == encoded.size();
+}
@@ -0,0 +1,266 @@
+#include "MeshData.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <unordered_map>
+#include <chrono>
+#include <iostream>
+#include <cmath>
+
+// All interleaved floats of a vertex, compared bit for bit when welding
+using VertexKey = std::array<float, MeshData::VERTEX_STRIDE>;
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        // FNV-1a over the raw bytes
+        unsigned char bytes[sizeof(VertexKey)];
+        std::memcpy(bytes, key.data(), sizeof(bytes));
+        size_t hash = 14695981039346656037ull;
+        for (unsigned char b : bytes) {
+            hash ^= b;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const std::array<float, 3>& key) const {
+        uint32_t bits[3];
+        std::memcpy(bits, key.data(), sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+MeshData MeshData::fromOBJ(const OBJMesh& obj) {
+    MeshData mesh;
+
+    // Texture slot of every material, shared between materials using the same image
+    std::vector<int> texIndices(obj.materials.size(), -1);
+    for (size_t m = 0; m < obj.materials.size(); ++m) {
+        const Material& material = obj.materials[m];
+        if (!material.diffuseTexturePath.empty()) {
+            const std::string& texPath = material.diffuseTexturePath;
+            auto it = std::find(mesh.texturePaths.begin(), mesh.texturePaths.end(), texPath);
+            if (it == mesh.texturePaths.end()) {
+                mesh.texturePaths.push_back(texPath);
+                texIndices[m] = mesh.texturePaths.size() - 1;
+            } else {
+                texIndices[m] = it - mesh.texturePaths.begin();
+            }
+        }
+    }
+
+    // One submesh per group and material pair, numbered by first appearance
+    size_t triangleCount = obj.triangleCount();
+    std::unordered_map<uint64_t, unsigned int> submeshLookup;
+    std::vector<unsigned int> triangleSubmesh(triangleCount);
+    std::vector<unsigned int> submeshTriangles;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        uint64_t key = ((uint64_t)obj.groupIndices[t] << 32) | obj.materialIndices[t];
+        auto [it, inserted] = submeshLookup.try_emplace(key, (unsigned int)mesh.submeshes.size());
+        if (inserted) {
+            Submesh submesh;
+            submesh.name = obj.groups[obj.groupIndices[t]];
+            submesh.material = obj.materials[obj.materialIndices[t]].name;
+            mesh.submeshes.push_back(submesh);
+            submeshTriangles.push_back(0);
+        }
+        triangleSubmesh[t] = it->second;
+        submeshTriangles[it->second]++;
+    }
+
+    // Counting sort of the triangles by submesh, keeping file order within each
+    std::vector<unsigned int> submeshStart(mesh.submeshes.size() + 1, 0);
+    for (size_t s = 0; s < mesh.submeshes.size(); ++s) {
+        submeshStart[s + 1] = submeshStart[s] + submeshTriangles[s];
+        mesh.submeshes[s].lods.push_back({submeshStart[s] * 3, submeshTriangles[s] * 3, 0.0f});
+    }
+    std::vector<unsigned int> triangleOrder(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleOrder[submeshStart[triangleSubmesh[t]]++] = t;
+
+    std::unordered_map<VertexKey, unsigned int, VertexKeyHash> vertexLookup;
+    vertexLookup.reserve(obj.positions.size());
+    mesh.indices.reserve(obj.positions.size());
+
+    for (size_t i = 0; i < obj.positions.size(); ++i) {
+        size_t c = triangleOrder[i / 3] * 3 + i % 3;
+        unsigned int materialIndex = obj.materialIndices[c / 3];
+        const Material& material = obj.materials[materialIndex];
+
+        if (material.opacity < 1.0f) {
+            mesh.hasTransparency = true;
+        }
+
+        const glm::vec3& p = obj.positions[c];
+        const glm::vec3& n = obj.normals[c];
+        const glm::vec2& t = obj.texcoords[c];
+        VertexKey key = {
+            p.x, p.y, p.z,
+            n.x, n.y, n.z,
+            t.x, t.y,
+            (float)texIndices[materialIndex],
+            material.diffuseColor.r, material.diffuseColor.g, material.diffuseColor.b,
+            material.opacity
+        };
+
+        auto [it, inserted] = vertexLookup.try_emplace(key, (unsigned int)mesh.vertexCount());
+        if (inserted)
+            mesh.vertices.insert(mesh.vertices.end(), key.begin(), key.end());
+        mesh.indices.push_back(it->second);
+    }
+
+    mesh.computeBounds();
+    return mesh;
+}
+
+void MeshData::extract(size_t indexOffset, size_t indexCount, std::vector<float>& localVertices,
+                       std::vector<unsigned int>& localIndices, std::vector<unsigned int>& globalIds) const {
+    globalIds.assign(indices.begin() + indexOffset, indices.begin() + indexOffset + indexCount);
+    std::sort(globalIds.begin(), globalIds.end());
+    globalIds.erase(std::unique(globalIds.begin(), globalIds.end()), globalIds.end());
+
+    localIndices.resize(indexCount);
+    for (size_t i = 0; i < indexCount; ++i)
+        localIndices[i] = std::lower_bound(globalIds.begin(), globalIds.end(), indices[indexOffset + i]) - globalIds.begin();
+
+    localVertices.resize(globalIds.size() * VERTEX_STRIDE);
+    for (size_t v = 0; v < globalIds.size(); ++v)
+        std::copy_n(&vertices[globalIds[v] * VERTEX_STRIDE], VERTEX_STRIDE, &localVertices[v * VERTEX_STRIDE]);
+}
+
+MeshData MeshData::load(const std::string& path) {
+    auto startTime = std::chrono::steady_clock::now();
+    MeshData mesh;
+    bool cached = MeshCache::load(path, mesh);
+    if (!cached) {
+        OBJMesh obj = OBJLoader::loadOBJ(path, true, CREASE_ANGLE);
+        mesh = MeshData::fromOBJ(obj);
+        // Meshlets decide the triangle order, so the rest of the ordering runs after them
+        MeshOptimizer::CacheStats welded = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertexCount());
+        MeshletBuilder::build(mesh, path);
+        MeshSimplifier::buildLODs(mesh, path, std::vector<float>(std::begin(LOD_RATIOS), std::end(LOD_RATIOS)));
+        MeshOptimizer::optimize(mesh, path, welded);
+        MeshCache::save(path, mesh, obj.materialLibraries);
+
+        size_t cornerCount = obj.positions.size();
+        std::cout << "Welded " << path << ": " << cornerCount << " -> " << mesh.vertexCount() << " vertices";
+        if (cornerCount > 0)
+            std::cout << " (" << 100.0 * (1.0 - (double)mesh.vertexCount() / cornerCount) << "% fewer)";
+        std::cout << std::endl;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << (cached ? "Warm load " : "Cold load ") << path << ": " << ms << " ms" << std::endl;
+    return mesh;
+}
+
+std::vector<unsigned int> MeshData::positionIds(const std::vector<float>& vertices, size_t stride,
+                                                size_t& positionCount) {
+    size_t vertexCount = vertices.size() / stride;
+    std::vector<unsigned int> ids(vertexCount);
+
+    // Compared bit for bit like the welding keys
+    std::unordered_map<std::array<float, 3>, unsigned int, PositionKeyHash> lookup;
+    lookup.reserve(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const float* p = &vertices[v * stride];
+        auto [it, inserted] = lookup.try_emplace({p[0], p[1], p[2]}, (unsigned int)lookup.size());
+        ids[v] = it->second;
+    }
+    positionCount = lookup.size();
+    return ids;
+}
+
+void MeshData::computeBounds() {
+    if (vertices.empty()) {
+        boundsMin = boundsMax = glm::vec3(0.0f);
+        return;
+    }
+
+    boundsMin = glm::vec3(vertices[0], vertices[1], vertices[2]);
+    boundsMax = boundsMin;
+    for (size_t i = 0; i < vertices.size(); i += VERTEX_STRIDE) {
+        glm::vec3 p(vertices[i], vertices[i + 1], vertices[i + 2]);
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+
+    for (Submesh& submesh : submeshes) {
+        const LOD& full = submesh.lods[0];
+        if (full.indexCount == 0) continue;
+        const float* first = &vertices[indices[full.indexOffset] * VERTEX_STRIDE];
+        submesh.boundsMin = submesh.boundsMax = glm::vec3(first[0], first[1], first[2]);
+        for (size_t i = full.indexOffset; i < full.indexOffset + full.indexCount; ++i) {
+            const float* v = &vertices[indices[i] * VERTEX_STRIDE];
+            submesh.boundsMin = glm::min(submesh.boundsMin, glm::vec3(v[0], v[1], v[2]));
+            submesh.boundsMax = glm::max(submesh.boundsMax, glm::vec3(v[0], v[1], v[2]));
+        }
+    }
+}
+
+// Octahedral mapping of a unit vector onto [-1, 1]^2
+static glm::vec2 octahedralEncode(glm::vec3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f) {
+        e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) *
+            glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return e;
+}
+
+void MeshData::compact(std::vector<CompactVertex>& compactVertices, std::vector<CompactMaterial>& materials) const {
+    compactVertices.resize(vertexCount());
+    materials.clear();
+
+    // Flat axes quantize to 0, the shader multiplies them by a zero extent
+    glm::vec3 extent = boundsMax - boundsMin;
+    glm::vec3 scale(
+        extent.x > 0.0f ? 65535.0f / extent.x : 0.0f,
+        extent.y > 0.0f ? 65535.0f / extent.y : 0.0f,
+        extent.z > 0.0f ? 65535.0f / extent.z : 0.0f);
+
+    for (size_t v = 0; v < compactVertices.size(); ++v) {
+        const float* src = &vertices[v * VERTEX_STRIDE];
+        CompactVertex& dst = compactVertices[v];
+
+        glm::vec3 q = glm::clamp((glm::vec3(src[0], src[1], src[2]) - boundsMin) * scale + 0.5f, 0.0f, 65535.0f);
+        dst.position[0] = (uint16_t)q.x;
+        dst.position[1] = (uint16_t)q.y;
+        dst.position[2] = (uint16_t)q.z;
+
+        glm::vec3 normal(src[3], src[4], src[5]);
+        if (glm::dot(normal, normal) > 0.0f) {
+            glm::vec2 e = octahedralEncode(normal);
+            dst.normal[0] = (int16_t)glm::packSnorm1x16(e.x);
+            dst.normal[1] = (int16_t)glm::packSnorm1x16(e.y);
+        } else {
+            dst.normal[0] = dst.normal[1] = 0;
+        }
+
+        dst.texcoord[0] = glm::packHalf1x16(src[6]);
+        dst.texcoord[1] = glm::packHalf1x16(src[7]);
+
+        CompactMaterial material;
+        material.textureIndex = (int)src[8];
+        material.diffuseColor = glm::vec3(src[9], src[10], src[11]);
+        material.opacity = src[12];
+
+        // Meshes only have a handful of materials, a linear search is fine
+        size_t m = 0;
+        while (m < materials.size() &&
+               (materials[m].textureIndex != material.textureIndex ||
+                materials[m].diffuseColor != material.diffuseColor ||
+                materials[m].opacity != material.opacity))
+            m++;
+        if (m == materials.size())
+            materials.push_back(material);
+        dst.material = (uint16_t)m;
+    }
+}
@@ -0,0 +1,259 @@
+#include "MeshOptimizer.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <iostream>
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const std::vector<unsigned int>& indices,
+                                                            size_t vertexCount, unsigned int cacheSize) {
+    CacheStats stats;
+    if (indices.empty() || vertexCount == 0) return stats;
+
+    // Timestamp of when each vertex entered the FIFO, a vertex is cached while
+    // fewer than cacheSize others entered after it
+    std::vector<size_t> insertedAt(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    size_t misses = 0;
+
+    for (unsigned int v : indices) {
+        if (time - insertedAt[v] > cacheSize) {
+            insertedAt[v] = time++;
+            misses++;
+        }
+    }
+
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / vertexCount;
+    return stats;
+}
+
+// Vertex scoring from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+namespace {
+    constexpr int FORSYTH_CACHE_SIZE = 32;
+    constexpr float CACHE_DECAY_POWER = 1.5f;
+    constexpr float LAST_TRI_SCORE = 0.75f;
+    constexpr float VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+    float vertexScore(int cachePosition, unsigned int remainingValence) {
+        if (remainingValence == 0) return -1.0f; // Not needed by any triangle anymore
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // Used by the last triangle, deliberately a bit lower so the next
+                // triangle doesn't just reuse the same edge
+                score = LAST_TRI_SCORE;
+            } else {
+                float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+
+        // Boost vertices with few triangles left so lone ones get cleaned up early
+        score += VALENCE_BOOST_SCALE * std::pow((float)remainingValence, -VALENCE_BOOST_POWER);
+        return score;
+    }
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    size_t triCount = indices.size() / 3;
+    if (triCount == 0) return;
+
+    // Triangle adjacency per vertex, entries of emitted triangles are swapped out of the live range
+    std::vector<unsigned int> valence(vertexCount, 0);
+    for (unsigned int v : indices) valence[v]++;
+
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + valence[v];
+
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t t = 0; t < triCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        score[v] = vertexScore(-1, valence[v]);
+
+    std::vector<float> triScore(triCount);
+    std::vector<char> emitted(triCount, 0);
+    for (size_t t = 0; t < triCount; ++t)
+        triScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    std::vector<unsigned int> cache, newCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    int bestTri = std::max_element(triScore.begin(), triScore.end()) - triScore.begin();
+    size_t scanPosition = 0;
+
+    for (size_t emittedCount = 0; emittedCount < triCount; ++emittedCount) {
+        if (bestTri < 0) {
+            // Dead end: nothing in the cache has triangles left, continue with the next unused one
+            while (emitted[scanPosition]) scanPosition++;
+            bestTri = scanPosition;
+        }
+
+        const unsigned int* tri = &indices[bestTri * 3];
+        emitted[bestTri] = 1;
+        output.insert(output.end(), tri, tri + 3);
+
+        // Remove the triangle from the adjacency of its vertices
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = tri[k];
+            unsigned int begin = adjacencyOffset[v];
+            unsigned int end = begin + valence[v];
+            for (unsigned int a = begin; a < end; ++a) {
+                if (adjacency[a] == (unsigned int)bestTri) {
+                    std::swap(adjacency[a], adjacency[end - 1]);
+                    break;
+                }
+            }
+            valence[v]--;
+        }
+
+        // The triangle's vertices move to the front of the LRU cache
+        newCache.assign(tri, tri + 3);
+        for (unsigned int v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache.push_back(v);
+
+        for (size_t i = 0; i < newCache.size(); ++i) {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < (size_t)FORSYTH_CACHE_SIZE ? (int)i : -1;
+            score[v] = vertexScore(cachePosition[v], valence[v]);
+        }
+
+        // Rescore the live triangles touching the cache and pick the best one
+        bestTri = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : newCache) {
+            unsigned int begin = adjacencyOffset[v];
+            for (unsigned int a = begin; a < begin + valence[v]; ++a) {
+                unsigned int t = adjacency[a];
+                const unsigned int* other = &indices[t * 3];
+                triScore[t] = score[other[0]] + score[other[1]] + score[other[2]];
+                if (triScore[t] > bestScore) {
+                    bestScore = triScore[t];
+                    bestTri = t;
+                }
+            }
+        }
+
+        if (newCache.size() > (size_t)FORSYTH_CACHE_SIZE)
+            newCache.resize(FORSYTH_CACHE_SIZE);
+        std::swap(cache, newCache);
+    }
+
+    indices.swap(output);
+}
+
+void MeshOptimizer::optimizeOverdraw(MeshData& mesh, float threshold) {
+    auto position = [&](unsigned int v) {
+        const float* p = &mesh.vertices[v * MeshData::VERTEX_STRIDE];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    std::vector<unsigned int> output;
+    for (MeshData::Submesh& submesh : mesh.submeshes) {
+        size_t meshletCount = submesh.meshletCount;
+        if (meshletCount < 2) continue;
+        auto meshlets = mesh.meshlets.begin() + submesh.meshletOffset;
+        size_t rangeStart = meshlets[0].indexOffset;
+        size_t rangeEnd = meshlets[meshletCount - 1].indexOffset + meshlets[meshletCount - 1].indexCount;
+
+        // Submesh centroid and the area weighted centroid and normal of each meshlet
+        glm::vec3 center(0.0f);
+        float totalArea = 0.0f;
+        std::vector<glm::vec3> meshletCenter(meshletCount), meshletNormal(meshletCount);
+        for (size_t m = 0; m < meshletCount; ++m) {
+            glm::vec3 sum(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (size_t i = meshlets[m].indexOffset; i < meshlets[m].indexOffset + meshlets[m].indexCount; i += 3) {
+                glm::vec3 a = position(mesh.indices[i]);
+                glm::vec3 b = position(mesh.indices[i + 1]);
+                glm::vec3 c = position(mesh.indices[i + 2]);
+                glm::vec3 n = glm::cross(b - a, c - a);
+                float triArea = glm::length(n);
+                sum += (a + b + c) * (triArea / 3.0f);
+                normal += n;
+                area += triArea;
+            }
+            meshletCenter[m] = area > 0.0f ? sum / area : meshlets[m].center;
+            meshletNormal[m] = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+            center += sum;
+            totalArea += area;
+        }
+        if (totalArea > 0.0f) center /= totalArea;
+
+        // Meshlets facing away from the center are likely in front of the others, draw them first
+        std::vector<float> sortKey(meshletCount);
+        for (size_t m = 0; m < meshletCount; ++m)
+            sortKey[m] = glm::dot(meshletCenter[m] - center, meshletNormal[m]);
+        std::vector<size_t> order(meshletCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+        std::vector<MeshData::Meshlet> sorted;
+        sorted.reserve(meshletCount);
+        output.clear();
+        for (size_t m : order) {
+            sorted.push_back(meshlets[m]);
+            sorted.back().indexOffset = rangeStart + output.size();
+            output.insert(output.end(), mesh.indices.begin() + meshlets[m].indexOffset,
+                          mesh.indices.begin() + meshlets[m].indexOffset + meshlets[m].indexCount);
+        }
+
+        // Keep the old order if the restarts between meshlets cost more than allowed
+        std::vector<unsigned int> current(mesh.indices.begin() + rangeStart, mesh.indices.begin() + rangeEnd);
+        float before = analyzeVertexCache(current, mesh.vertexCount()).acmr;
+        float after = analyzeVertexCache(output, mesh.vertexCount()).acmr;
+        if (after > before * threshold) continue;
+        std::copy(output.begin(), output.end(), mesh.indices.begin() + rangeStart);
+        std::copy(sorted.begin(), sorted.end(), meshlets);
+    }
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices, size_t stride) {
+    size_t vertexCount = vertices.size() / stride;
+    std::vector<unsigned int> remap(vertexCount, ~0u);
+    std::vector<float> output;
+    output.reserve(vertices.size());
+
+    unsigned int next = 0;
+    for (unsigned int& index : indices) {
+        if (remap[index] == ~0u) {
+            remap[index] = next++;
+            output.insert(output.end(), vertices.begin() + index * stride, vertices.begin() + (index + 1) * stride);
+        }
+        index = remap[index];
+    }
+
+    // Vertices no triangle uses are dropped
+    vertices.swap(output);
+}
+
+void MeshOptimizer::optimize(MeshData& mesh, const std::string& name, const CacheStats& before) {
+    if (mesh.indices.empty()) return;
+
+    optimizeOverdraw(mesh);
+    // After everything else that orders indices, so vertices follow the uploaded order
+    optimizeVertexFetch(mesh.vertices, mesh.indices, MeshData::VERTEX_STRIDE);
+
+    // The finest LODs come first in indices, the coarser ones were appended after them
+    size_t finestCount = 0;
+    for (const MeshData::Submesh& submesh : mesh.submeshes)
+        finestCount += submesh.lods[0].indexCount;
+    std::vector<unsigned int> finest(mesh.indices.begin(), mesh.indices.begin() + finestCount);
+    CacheStats after = analyzeVertexCache(finest, mesh.vertexCount());
+    std::cout << "Optimized " << name << ": ACMR " << before.acmr << " -> " << after.acmr
+              << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+}
@@ -0,0 +1,104 @@
+#include "MeshRegistry.h"
+#include "AssetLoader.h"
+#include <filesystem>
+#include <algorithm>
+
+MeshRegistry& MeshRegistry::instance() {
+    static MeshRegistry registry;
+    return registry;
+}
+
+std::string MeshRegistry::makeKey(const std::string& path) {
+    std::error_code ec;
+    std::string key = std::filesystem::weakly_canonical(path, ec).string();
+    return ec ? path : key;
+}
+
+std::shared_ptr<Mesh> MeshRegistry::find(const std::string& path, Residency residency, bool& created) {
+    std::string key = makeKey(path);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = meshes.find(key);
+    created = it == meshes.end();
+    if (!created) {
+        counters.hits++;
+        return it->second;
+    }
+
+    counters.misses++;
+    counters.meshCount++;
+    auto mesh = std::make_shared<Mesh>();
+    mesh->residency = residency;
+    meshes.emplace(key, mesh);
+    return mesh;
+}
+
+std::shared_ptr<Mesh> MeshRegistry::acquire(const std::string& path, Residency residency) {
+    bool created;
+    std::shared_ptr<Mesh> mesh = find(path, residency, created);
+    if (created)
+        mesh->upload(MeshData::load(path));
+    return mesh;
+}
+
+std::shared_ptr<Mesh> MeshRegistry::acquireAsync(const std::string& path, AssetLoader& loader,
+                                               Residency residency) {
+    bool created;
+    std::shared_ptr<Mesh> mesh = find(path, residency, created);
+    if (created)
+        loader.load(mesh, path);
+    return mesh;
+}
+
+size_t MeshRegistry::restoreAll() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t restored = 0;
+    for (auto& [key, mesh] : meshes)
+        restored += mesh->restore();
+    return restored;
+}
+
+size_t MeshRegistry::evictUnused() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t evicted = 0;
+    for (auto it = meshes.begin(); it != meshes.end();) {
+        // Only the registry's own reference is left, and find() can't hand out another meanwhile
+        if (it->second.use_count() == 1) {
+            it->second->release();
+            it = meshes.erase(it);
+            counters.meshCount--;
+            evicted++;
+        } else {
+            ++it;
+        }
+    }
+    return evicted;
+}
+
+void MeshRegistry::releaseAll() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& [key, mesh] : meshes)
+        mesh->release();
+}
+
+MeshStats MeshRegistry::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+std::vector<MeshMemory> MeshRegistry::memoryReport() const {
+    std::vector<MeshMemory> report;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& [key, mesh] : meshes) {
+            MeshMemory entry;
+            entry.path = key;
+            entry.residency = mesh->residency;
+            entry.users = mesh.use_count() - 1; // Not counting the registry
+            entry.usage = mesh->memoryUsage();
+            report.push_back(entry);
+        }
+    }
+    std::sort(report.begin(), report.end(), [](const MeshMemory& a, const MeshMemory& b) { return a.path < b.path; });
+    return report;
+}
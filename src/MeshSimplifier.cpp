@@ -0,0 +1,418 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <unordered_map>
+#include <queue>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+namespace {
+    // Weighted sum of squared distances to a set of planes, x^T A x + 2 b.x + c
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+
+        void addPlane(const glm::dvec3& n, double d, double weight) {
+            a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z;
+            a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a22 += weight * n.z * n.z;
+            b0 += weight * n.x * d; b1 += weight * n.y * d; b2 += weight * n.z * d;
+            c += weight * d * d;
+            this->weight += weight;
+        }
+
+        Quadric& operator+=(const Quadric& q) {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2;
+            c += q.c;
+            weight += q.weight;
+            return *this;
+        }
+
+        double evaluate(const glm::dvec3& p) const {
+            double r = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                     + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                     + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return std::max(r, 0.0);
+        }
+    };
+
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    class Simplifier {
+    public:
+        Simplifier(const std::vector<float>& vertices, size_t stride, const std::vector<unsigned int>& indices)
+            : vertices(vertices), stride(stride), corners(indices) {
+            size_t vertexCount = vertices.size() / stride;
+            size_t triangleCount = indices.size() / 3;
+
+            // Vertices sharing a position collapse together, each keeping its own attributes
+            size_t positionCount;
+            positionOf = MeshData::positionIds(vertices, stride, positionCount);
+            positions.resize(positionCount);
+            for (size_t v = 0; v < vertexCount; ++v) {
+                const float* p = &vertices[v * stride];
+                positions[positionOf[v]] = glm::dvec3(p[0], p[1], p[2]);
+            }
+
+            quadrics.resize(positionCount);
+            triangles.resize(positionCount);
+            removed.assign(positionCount, 0);
+            locked.assign(positionCount, 0);
+            border.assign(positionCount, 0);
+            alive.assign(triangleCount, 1);
+            liveTriangles = triangleCount;
+
+            glm::dvec3 boundsMin(positions.empty() ? glm::dvec3(0.0) : positions[0]), boundsMax(boundsMin);
+            for (const glm::dvec3& p : positions) {
+                boundsMin = glm::min(boundsMin, p);
+                boundsMax = glm::max(boundsMax, p);
+            }
+            double diagonal = glm::length(boundsMax - boundsMin);
+            // A 26 degree normal change weighs like moving 1% of the mesh size
+            attributeWeight = 1e-3 * diagonal * diagonal;
+
+            std::unordered_map<uint64_t, unsigned int> edgeUses;
+            for (size_t t = 0; t < triangleCount; ++t) {
+                unsigned int p0 = position(t, 0), p1 = position(t, 1), p2 = position(t, 2);
+                if (p0 == p1 || p1 == p2 || p2 == p0) {
+                    alive[t] = 0;
+                    liveTriangles--;
+                    continue;
+                }
+
+                // Area weighted plane of the triangle
+                glm::dvec3 n = glm::cross(positions[p1] - positions[p0], positions[p2] - positions[p0]);
+                double area = glm::length(n);
+                if (area > 0.0) {
+                    n /= area;
+                    Quadric q;
+                    q.addPlane(n, -glm::dot(n, positions[p0]), area);
+                    quadrics[p0] += q;
+                    quadrics[p1] += q;
+                    quadrics[p2] += q;
+                }
+
+                for (int k = 0; k < 3; ++k) {
+                    triangles[position(t, k)].push_back(t);
+                    edgeUses[edgeKey(position(t, k), position(t, (k + 1) % 3))]++;
+                }
+            }
+
+            // Open borders only slide along themselves and are held in place by planes
+            // perpendicular to their triangle, non-manifold edges are never touched
+            for (size_t t = 0; t < triangleCount; ++t) {
+                if (!alive[t]) continue;
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int a = position(t, k), b = position(t, (k + 1) % 3);
+                    unsigned int uses = edgeUses[edgeKey(a, b)];
+                    if (uses == 1) {
+                        border[a] = border[b] = 1;
+                        glm::dvec3 edge = positions[b] - positions[a];
+                        glm::dvec3 normal = glm::cross(edge, positions[position(t, (k + 2) % 3)] - positions[a]);
+                        glm::dvec3 n = glm::cross(edge, normal);
+                        double length = glm::length(n);
+                        if (length > 0.0) {
+                            n /= length;
+                            Quadric q;
+                            q.addPlane(n, -glm::dot(n, positions[a]), glm::dot(edge, edge));
+                            quadrics[a] += q;
+                            quadrics[b] += q;
+                        }
+                    } else if (uses > 2) {
+                        locked[a] = locked[b] = 1;
+                    }
+                }
+            }
+
+            for (size_t t = 0; t < triangleCount; ++t) {
+                if (!alive[t]) continue;
+                for (int k = 0; k < 3; ++k)
+                    pushCollapse(position(t, k), position(t, (k + 1) % 3));
+            }
+        }
+
+        // Collapse until the triangle count reaches target or nothing can collapse anymore
+        void run(size_t target) {
+            while (liveTriangles > target && !queue.empty()) {
+                Collapse collapse = queue.top();
+                queue.pop();
+                if (removed[collapse.from] || removed[collapse.to]) continue;
+
+                double cost, geometricError;
+                if (!evaluate(collapse.from, collapse.to, cost, geometricError, mapping)) continue;
+
+                // Stale entry from before a neighbouring collapse, retry at its real cost
+                if (cost > collapse.cost * 1.000001 + 1e-30) {
+                    queue.push({cost, collapse.from, collapse.to});
+                    continue;
+                }
+
+                apply(collapse.from, collapse.to);
+                maxError = std::max(maxError, geometricError);
+            }
+        }
+
+        std::vector<unsigned int> liveIndices() const {
+            std::vector<unsigned int> result;
+            result.reserve(liveTriangles * 3);
+            for (size_t t = 0; t < alive.size(); ++t)
+                if (alive[t]) result.insert(result.end(), &corners[t * 3], &corners[t * 3] + 3);
+            return result;
+        }
+
+        size_t triangleCount() const { return liveTriangles; }
+        float error() const { return (float)std::sqrt(maxError); }
+
+    private:
+        const std::vector<float>& vertices;
+        size_t stride;
+        std::vector<unsigned int> corners; // Vertex per triangle corner, updated as collapses happen
+        std::vector<unsigned int> positionOf;
+        std::vector<glm::dvec3> positions;
+        std::vector<Quadric> quadrics;
+        std::vector<std::vector<unsigned int>> triangles; // Triangles around each position, may hold dead ones
+        std::vector<char> removed, locked, border, alive;
+        size_t liveTriangles = 0;
+        double attributeWeight = 0.0;
+        double maxError = 0.0;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+        // Scratch for evaluate()
+        std::vector<std::pair<unsigned int, unsigned int>> mapping;
+        std::vector<unsigned int> neighboursA, neighboursB, wedgesB;
+
+        unsigned int position(size_t t, int k) const { return positionOf[corners[t * 3 + k]]; }
+
+        static uint64_t edgeKey(unsigned int a, unsigned int b) {
+            if (a > b) std::swap(a, b);
+            return ((uint64_t)a << 32) | b;
+        }
+
+        bool contains(size_t t, unsigned int p) const {
+            return position(t, 0) == p || position(t, 1) == p || position(t, 2) == p;
+        }
+
+        void pushCollapse(unsigned int from, unsigned int to) {
+            double cost, geometricError;
+            if (evaluate(from, to, cost, geometricError, mapping))
+                queue.push({cost, from, to});
+        }
+
+        void collectNeighbours(unsigned int p, std::vector<unsigned int>& out) const {
+            out.clear();
+            for (unsigned int t : triangles[p]) {
+                if (!alive[t]) continue;
+                for (int k = 0; k < 3; ++k)
+                    if (position(t, k) != p) out.push_back(position(t, k));
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }
+
+        // Vertices only merge with vertices of the same material
+        bool sameMaterial(unsigned int a, unsigned int b) const {
+            const float* va = &vertices[a * stride];
+            const float* vb = &vertices[b * stride];
+            return std::memcmp(va + 8, vb + 8, (stride - 8) * sizeof(float)) == 0;
+        }
+
+        double attributeDistance(unsigned int a, unsigned int b) const {
+            const float* va = &vertices[a * stride];
+            const float* vb = &vertices[b * stride];
+            glm::vec3 na(va[3], va[4], va[5]), nb(vb[3], vb[4], vb[5]);
+            glm::vec2 ta(va[6], va[7]), tb(vb[6], vb[7]);
+            float normalDot = glm::dot(na, nb);
+            float lengths = glm::length(na) * glm::length(nb);
+            float normalDistance = lengths > 0.0f ? std::max(1.0f - normalDot / lengths, 0.0f) : 0.0f;
+            return normalDistance + glm::dot(ta - tb, ta - tb);
+        }
+
+        // Cost of moving position from onto position to, and which vertex each vertex at from becomes
+        bool evaluate(unsigned int from, unsigned int to, double& cost, double& geometricError,
+                      std::vector<std::pair<unsigned int, unsigned int>>& vertexMap) {
+            if (locked[from]) return false;
+
+            unsigned int shared = 0;
+            for (unsigned int t : triangles[from])
+                if (alive[t] && contains(t, to)) shared++;
+            if (shared == 0) return false;
+
+            // Borders stay in place except along their own edges
+            if (border[from] && !(border[to] && shared == 1)) return false;
+
+            // Link condition: the edge's triangles must be the only thing the two ends share,
+            // otherwise the collapse pinches the surface
+            collectNeighbours(from, neighboursA);
+            collectNeighbours(to, neighboursB);
+            size_t common = 0;
+            for (size_t i = 0, j = 0; i < neighboursA.size() && j < neighboursB.size();) {
+                if (neighboursA[i] < neighboursB[j]) i++;
+                else if (neighboursA[i] > neighboursB[j]) j++;
+                else { common++; i++; j++; }
+            }
+            if (common != shared) return false;
+
+            // Vertices around to that a vertex around from may turn into
+            wedgesB.clear();
+            for (unsigned int t : triangles[to]) {
+                if (!alive[t]) continue;
+                for (int k = 0; k < 3; ++k)
+                    if (position(t, k) == to) wedgesB.push_back(corners[t * 3 + k]);
+            }
+            std::sort(wedgesB.begin(), wedgesB.end());
+            wedgesB.erase(std::unique(wedgesB.begin(), wedgesB.end()), wedgesB.end());
+
+            vertexMap.clear();
+            double attributeError = 0.0;
+            for (unsigned int t : triangles[from]) {
+                if (!alive[t] || contains(t, to)) continue;
+
+                // Triangles must not flip or degenerate
+                glm::dvec3 p[3], q[3];
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int pk = position(t, k);
+                    p[k] = positions[pk];
+                    q[k] = pk == from ? positions[to] : p[k];
+                }
+                glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::dvec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                double afterLength = glm::length(after);
+                if (afterLength <= 0.0 || glm::dot(before, after) < 0.2 * glm::length(before) * afterLength)
+                    return false;
+
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int v = corners[t * 3 + k];
+                    if (positionOf[v] != from) continue;
+                    if (std::find_if(vertexMap.begin(), vertexMap.end(),
+                                     [v](const auto& m) { return m.first == v; }) != vertexMap.end())
+                        continue;
+
+                    unsigned int best = ~0u;
+                    double bestDistance = 0.0;
+                    for (unsigned int w : wedgesB) {
+                        if (!sameMaterial(v, w)) continue;
+                        double distance = attributeDistance(v, w);
+                        if (best == ~0u || distance < bestDistance) {
+                            best = w;
+                            bestDistance = distance;
+                        }
+                    }
+                    // A material border can only move along itself
+                    if (best == ~0u) return false;
+                    vertexMap.emplace_back(v, best);
+                    attributeError += bestDistance;
+                }
+            }
+
+            Quadric q = quadrics[from];
+            q += quadrics[to];
+            // Mean squared distance, so the error is comparable to sizes on screen
+            geometricError = q.weight > 0.0 ? q.evaluate(positions[to]) / q.weight : 0.0;
+            cost = geometricError + attributeWeight * attributeError;
+            return true;
+        }
+
+        void apply(unsigned int from, unsigned int to) {
+            for (unsigned int t : triangles[from]) {
+                if (!alive[t]) continue;
+                if (contains(t, to)) {
+                    alive[t] = 0;
+                    liveTriangles--;
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int& v = corners[t * 3 + k];
+                    if (positionOf[v] != from) continue;
+                    for (const auto& m : mapping)
+                        if (m.first == v) { v = m.second; break; }
+                }
+                triangles[to].push_back(t);
+            }
+            std::vector<unsigned int>().swap(triangles[from]);
+            quadrics[to] += quadrics[from];
+            removed[from] = 1;
+
+            // Drop dead triangles so the lists don't grow without bound
+            auto& around = triangles[to];
+            around.erase(std::remove_if(around.begin(), around.end(), [this](unsigned int t) { return !alive[t]; }),
+                         around.end());
+
+            // Costs around the merged position changed
+            collectNeighbours(to, neighboursB);
+            std::vector<unsigned int> neighbours = neighboursB;
+            for (unsigned int n : neighbours) {
+                pushCollapse(to, n);
+                pushCollapse(n, to);
+            }
+        }
+    };
+}
+
+std::vector<std::vector<unsigned int>> MeshSimplifier::simplify(const std::vector<float>& vertices, size_t stride,
+                                                                const std::vector<unsigned int>& indices,
+                                                                const std::vector<size_t>& targetTriangles,
+                                                                std::vector<float>& errors) {
+    std::vector<std::vector<unsigned int>> levels;
+    errors.clear();
+    if (indices.empty()) return levels;
+
+    Simplifier simplifier(vertices, stride, indices);
+    size_t previous = indices.size() / 3;
+    for (size_t target : targetTriangles) {
+        simplifier.run(target);
+
+        // Stop once the mesh is stuck, a level barely smaller than the last isn't worth keeping,
+        // nor is one that collapsed away entirely
+        if (simplifier.triangleCount() == 0 || simplifier.triangleCount() > previous * 9 / 10) break;
+        previous = simplifier.triangleCount();
+
+        levels.push_back(simplifier.liveIndices());
+        errors.push_back(simplifier.error());
+    }
+    return levels;
+}
+
+void MeshSimplifier::buildLODs(MeshData& mesh, const std::string& name, const std::vector<float>& ratios) {
+    // Each submesh is simplified on its own, so its LODs stay within its material and bounds
+    size_t triangleCount = 0;
+    std::vector<size_t> levelTriangles(ratios.size(), 0);
+    std::vector<float> levelErrors(ratios.size(), 0.0f);
+    std::vector<float> localVertices, errors;
+    std::vector<unsigned int> localIndices, globalIds;
+    for (MeshData::Submesh& submesh : mesh.submeshes) {
+        submesh.lods.resize(1);
+        const MeshData::LOD full = submesh.lods[0];
+        size_t submeshTriangles = full.indexCount / 3;
+        triangleCount += submeshTriangles;
+        if (submeshTriangles == 0) continue;
+
+        std::vector<size_t> targets;
+        for (float ratio : ratios)
+            targets.push_back((size_t)(submeshTriangles * ratio));
+
+        mesh.extract(full.indexOffset, full.indexCount, localVertices, localIndices, globalIds);
+        auto levels = simplify(localVertices, MeshData::VERTEX_STRIDE, localIndices, targets, errors);
+
+        for (size_t i = 0; i < levels.size(); ++i) {
+            MeshOptimizer::optimizeVertexCache(levels[i], globalIds.size());
+            submesh.lods.push_back({(unsigned int)mesh.indices.size(), (unsigned int)levels[i].size(), errors[i]});
+            for (unsigned int index : levels[i])
+                mesh.indices.push_back(globalIds[index]);
+            levelTriangles[i] += levels[i].size() / 3;
+            levelErrors[i] = std::max(levelErrors[i], errors[i]);
+        }
+    }
+
+    std::cout << "LODs " << name << ": " << triangleCount;
+    for (size_t i = 0; i < ratios.size() && levelTriangles[i] > 0; ++i)
+        std::cout << " -> " << levelTriangles[i] << " (error " << levelErrors[i] << ")";
+    std::cout << " triangles" << std::endl;
+}
@@ -0,0 +1,210 @@
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Bounding sphere and normal cone of a finished meshlet
+static void computeBounds(MeshData::Meshlet& meshlet, const std::vector<unsigned int>& indices,
+                          const std::vector<float>& vertices, size_t stride) {
+    auto position = [&](unsigned int v) {
+        return glm::vec3(vertices[v * stride], vertices[v * stride + 1], vertices[v * stride + 2]);
+    };
+
+    size_t begin = meshlet.indexOffset, end = meshlet.indexOffset + meshlet.indexCount;
+    glm::vec3 boundsMin = position(indices[begin]), boundsMax = boundsMin;
+    for (size_t i = begin; i < end; ++i) {
+        boundsMin = glm::min(boundsMin, position(indices[i]));
+        boundsMax = glm::max(boundsMax, position(indices[i]));
+    }
+    meshlet.center = (boundsMin + boundsMax) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (size_t i = begin; i < end; ++i)
+        meshlet.radius = std::max(meshlet.radius, glm::length(position(indices[i]) - meshlet.center));
+
+    // Cone around the average face normal that holds every face normal
+    std::vector<glm::vec3> normals;
+    glm::vec3 axis(0.0f);
+    for (size_t i = begin; i < end; i += 3) {
+        glm::vec3 a = position(indices[i]), b = position(indices[i + 1]), c = position(indices[i + 2]);
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        if (length <= 0.0f) continue;
+        normals.push_back(n / length);
+        axis += normals.back();
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength <= 0.0f) return;
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const glm::vec3& n : normals)
+        minDot = std::min(minDot, glm::dot(n, axis));
+
+    // Wider than a hemisphere (with some margin) is never entirely backfacing
+    if (minDot <= 0.1f) return;
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+std::vector<MeshData::Meshlet> MeshletBuilder::build(std::vector<unsigned int>& indices, size_t indexOffset,
+                                                     size_t indexCount, const std::vector<float>& vertices,
+                                                     size_t stride) {
+    std::vector<MeshData::Meshlet> meshlets;
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return meshlets;
+    const unsigned int* source = &indices[indexOffset];
+
+    // Triangles around each position, so clusters also grow across normal and UV seams
+    size_t positionCount;
+    std::vector<unsigned int> positionOf = MeshData::positionIds(vertices, stride, positionCount);
+    std::vector<unsigned int> adjacencyOffset(positionCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        adjacencyOffset[positionOf[source[i]] + 1]++;
+    for (size_t p = 0; p < positionCount; ++p)
+        adjacencyOffset[p + 1] += adjacencyOffset[p];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        adjacency[fill[positionOf[source[i]]]++] = i / 3;
+
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        glm::vec3 sum(0.0f);
+        for (int k = 0; k < 3; ++k) {
+            const float* p = &vertices[source[t * 3 + k] * stride];
+            sum += glm::vec3(p[0], p[1], p[2]);
+        }
+        centroids[t] = sum / 3.0f;
+    }
+
+    // Stamped with the meshlet they were last added to, or queued as a candidate for
+    std::vector<unsigned int> vertexStamp(vertices.size() / stride, ~0u);
+    std::vector<unsigned int> candidateStamp(triangleCount, ~0u);
+    std::vector<char> used(triangleCount, 0);
+    std::vector<unsigned int> output;
+    output.reserve(indexCount);
+
+    std::vector<unsigned int> candidates, localIndices, meshletVertices;
+    size_t scanPosition = 0;
+    while (true) {
+        while (scanPosition < triangleCount && used[scanPosition]) scanPosition++;
+        if (scanPosition == triangleCount) break;
+
+        unsigned int stamp = meshlets.size();
+        MeshData::Meshlet meshlet;
+        meshlet.indexOffset = indexOffset + output.size();
+        meshletVertices.clear();
+        candidates.clear();
+        glm::vec3 centroidSum(0.0f);
+        size_t meshletTriangles = 0;
+
+        auto newVertices = [&](size_t t) {
+            unsigned int a = source[t * 3], b = source[t * 3 + 1], c = source[t * 3 + 2];
+            size_t count = (vertexStamp[a] != stamp) + (vertexStamp[b] != stamp && b != a) +
+                           (vertexStamp[c] != stamp && c != a && c != b);
+            return count;
+        };
+
+        auto add = [&](size_t t) {
+            used[t] = 1;
+            meshletTriangles++;
+            centroidSum += centroids[t];
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = source[t * 3 + k];
+                output.push_back(v);
+                if (vertexStamp[v] != stamp) {
+                    vertexStamp[v] = stamp;
+                    meshletVertices.push_back(v);
+                }
+                unsigned int p = positionOf[v];
+                for (unsigned int a = adjacencyOffset[p]; a < adjacencyOffset[p + 1]; ++a) {
+                    unsigned int other = adjacency[a];
+                    if (!used[other] && candidateStamp[other] != stamp) {
+                        candidateStamp[other] = stamp;
+                        candidates.push_back(other);
+                    }
+                }
+            }
+        };
+
+        add(scanPosition);
+
+        // Grow with the neighbour that adds the fewest vertices, then the closest one
+        while (meshletTriangles < MAX_TRIANGLES) {
+            glm::vec3 center = centroidSum / (float)meshletTriangles;
+            size_t best = SIZE_MAX, bestNew = 4;
+            float bestDistance = 0.0f;
+            size_t keep = 0;
+            for (size_t c = 0; c < candidates.size(); ++c) {
+                unsigned int t = candidates[c];
+                if (used[t]) continue;
+                candidates[keep++] = t;
+
+                size_t added = newVertices(t);
+                if (meshletVertices.size() + added > MAX_VERTICES) continue;
+                float distance = glm::length(centroids[t] - center);
+                if (added < bestNew || (added == bestNew && distance < bestDistance)) {
+                    best = t;
+                    bestNew = added;
+                    bestDistance = distance;
+                }
+            }
+            candidates.resize(keep);
+            if (best == SIZE_MAX) break;
+            add(best);
+        }
+
+        // Growth order isn't cache friendly, reorder the meshlet on its own small vertex set
+        size_t first = meshlet.indexOffset - indexOffset;
+        localIndices.clear();
+        for (size_t i = first; i < output.size(); ++i)
+            localIndices.push_back(std::find(meshletVertices.begin(), meshletVertices.end(), output[i]) - meshletVertices.begin());
+        MeshOptimizer::optimizeVertexCache(localIndices, meshletVertices.size());
+        for (size_t i = 0; i < localIndices.size(); ++i)
+            output[first + i] = meshletVertices[localIndices[i]];
+
+        meshlet.indexCount = indexOffset + output.size() - meshlet.indexOffset;
+        meshlets.push_back(meshlet);
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin() + indexOffset);
+    for (MeshData::Meshlet& meshlet : meshlets)
+        computeBounds(meshlet, indices, vertices, stride);
+    return meshlets;
+}
+
+void MeshletBuilder::build(MeshData& mesh, const std::string& name) {
+    // Per submesh on its own vertices, so meshlets never straddle two of them
+    mesh.meshlets.clear();
+    size_t triangleCount = 0;
+    std::vector<float> localVertices;
+    std::vector<unsigned int> localIndices, globalIds;
+    for (MeshData::Submesh& submesh : mesh.submeshes) {
+        const MeshData::LOD& full = submesh.lods[0];
+        submesh.meshletOffset = mesh.meshlets.size();
+        submesh.meshletCount = 0;
+        if (full.indexCount == 0) continue;
+
+        mesh.extract(full.indexOffset, full.indexCount, localVertices, localIndices, globalIds);
+        std::vector<MeshData::Meshlet> meshlets = build(localIndices, 0, localIndices.size(), localVertices,
+                                                        MeshData::VERTEX_STRIDE);
+        for (size_t i = 0; i < localIndices.size(); ++i)
+            mesh.indices[full.indexOffset + i] = globalIds[localIndices[i]];
+        for (MeshData::Meshlet& meshlet : meshlets) {
+            meshlet.indexOffset += full.indexOffset;
+            mesh.meshlets.push_back(meshlet);
+        }
+        submesh.meshletCount = meshlets.size();
+        triangleCount += full.indexCount / 3;
+    }
+
+    std::cout << "Meshlets " << name << ": " << mesh.meshlets.size() << " for " << triangleCount << " triangles";
+    if (!mesh.meshlets.empty())
+        std::cout << " (" << (double)triangleCount / mesh.meshlets.size() << " per meshlet)";
+    std::cout << std::endl;
+}
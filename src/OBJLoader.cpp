@@ -1,222 +1,687 @@
 #include "OBJLoader.h"
 #include "Material.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
 #include <glm/glm.hpp>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
 #include <vector>
+#include <string_view>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <unordered_map>
+#include <atomic>
+#include <memory>
 
 struct FaceVertex {
     int v = 0, vt = 0, vn = 0;
+    unsigned char relative = 0; // Bits for negative indices that need the chunk offset added
 };
 
-// Triangulate a polygonal face using ear clipping
-static std::vector<Vertex> triangulateFace(std::vector<Vertex>& face) {
-    std::vector<Vertex> result;
+enum RelativeIndex : unsigned char {
+    RELATIVE_V  = 1 << 0,
+    RELATIVE_VT = 1 << 1,
+    RELATIVE_VN = 1 << 2
+};
+
+// Polygon normal by Newell's method, robust for concave and slightly non-planar faces
+static glm::vec3 polygonNormal(const std::vector<Vertex>& face) {
+    glm::vec3 normal(0.0f);
+    for (size_t i = 0; i < face.size(); ++i) {
+        const glm::vec3& a = face[i].point;
+        const glm::vec3& b = face[(i + 1) % face.size()].point;
+        normal.x += (a.y - b.y) * (a.z + b.z);
+        normal.y += (a.z - b.z) * (a.x + b.x);
+        normal.z += (a.x - b.x) * (a.y + b.y);
+    }
+    return normal;
+}
+
+static inline float cross2D(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+static inline bool pointInTriangle(const glm::vec2& P, const glm::vec2& A, const glm::vec2& B, const glm::vec2& C) {
+    float c1 = cross2D(A, B, P);
+    float c2 = cross2D(B, C, P);
+    float c3 = cross2D(C, A, P);
+
+    bool hasNeg = (c1 < 0) || (c2 < 0) || (c3 < 0);
+    bool hasPos = (c1 > 0) || (c2 > 0) || (c3 > 0);
+
+    return !(hasNeg && hasPos);
+}
+
+// Ear clipping over a doubly linked ring of the polygon corners. Only reflex corners
+// can lie inside an ear, so those are the only ones tested, which keeps mostly convex
+// polygons close to linear time.
+static void earClip(const std::vector<Vertex>& face, const glm::vec3& N, std::vector<Vertex>& result) {
     int n = face.size();
-    if (n < 3) return result;
-
-    // Create Plane for the face
-    glm::vec3 edge1 = face[1].point - face[0].point;
-    glm::vec3 edge2 = face[2].point - face[0].point;
-    glm::vec3 N = glm::normalize(glm::cross(edge1, edge2));
-    // Use U and V basis for the plane
-    glm::vec3 U = glm::normalize(edge1);
+
+    // Project vertices onto the plane of the face
+    glm::vec3 U = glm::normalize(face[1].point - face[0].point);
+    if (!std::isfinite(U.x) || std::abs(glm::dot(U, N)) > 0.99f)
+        U = glm::normalize(glm::cross(std::abs(N.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0), N));
     glm::vec3 V = glm::cross(N, U);
 
-    // Project vertices onto the 2D plane
-    std::vector<glm::vec2> projected;
-    projected.reserve(face.size());
-    for (const auto &p : face) {
-        glm::vec3 vec = p.point - face[0].point;
-        projected.emplace_back(glm::dot(vec, U), glm::dot(vec, V));
+    thread_local std::vector<glm::vec2> projected;
+    thread_local std::vector<int> prev, next;
+    thread_local std::vector<char> reflex;
+    thread_local std::vector<int> reflexList;
+
+    projected.resize(n);
+    prev.resize(n);
+    next.resize(n);
+    reflex.resize(n);
+    reflexList.clear();
+
+    for (int i = 0; i < n; ++i) {
+        glm::vec3 vec = face[i].point - face[0].point;
+        projected[i] = glm::vec2(glm::dot(vec, U), glm::dot(vec, V));
+        prev[i] = (i + n - 1) % n;
+        next[i] = (i + 1) % n;
     }
 
-    // Check orientation
-    float totalArea = 0.0f;
-    for (int i = 0; i < (int)projected.size(); i++) {
-        int j = (i + 1) % projected.size();
-        totalArea += (projected[j].x - projected[i].x) * (projected[j].y + projected[i].y);
+    // The ring runs counter-clockwise around N, so convex corners turn left
+    auto updateReflex = [&](int i) {
+        reflex[i] = cross2D(projected[prev[i]], projected[i], projected[next[i]]) <= 0.0f;
+    };
+    for (int i = 0; i < n; ++i) {
+        updateReflex(i);
+        if (reflex[i]) reflexList.push_back(i);
     }
-    bool ccw = (totalArea < 0.0f);
 
-    // Ensure counter-clockwise orientation
-    if (!ccw) {
-        std::reverse(face.begin(), face.end());
-        projected.clear();
-        projected.reserve(face.size());
+    auto isEar = [&](int i) {
+        if (reflex[i]) return false;
+        int a = prev[i], c = next[i];
+        const glm::vec2& A = projected[a];
+        const glm::vec2& B = projected[i];
+        const glm::vec2& C = projected[c];
+        for (int r : reflexList) {
+            // Reflex corners turn convex as ears are removed, but never the other way
+            if (!reflex[r] || r == a || r == c) continue;
+            const glm::vec2& P = projected[r];
+            if (P == A || P == B || P == C) continue;
+            if (pointInTriangle(P, A, B, C)) return false;
+        }
+        return true;
+    };
+
+    auto emit = [&](int a, int b, int c) {
+        result.push_back(face[a]);
+        result.push_back(face[b]);
+        result.push_back(face[c]);
+    };
 
-        // recompute projection for reversed vertex order
-        for (const auto &p : face) {
-            glm::vec3 vec = p.point - face[0].point;
-            projected.emplace_back(glm::dot(vec, U), glm::dot(vec, V));
+    int remaining = n;
+    int curr = 0;
+    int sinceLastEar = 0;
+    while (remaining > 3) {
+        if (isEar(curr)) {
+            int a = prev[curr], c = next[curr];
+            emit(a, curr, c);
+
+            // Unlink the ear tip, only its neighbours can change
+            next[a] = c;
+            prev[c] = a;
+            reflex[curr] = 0;
+            remaining--;
+            updateReflex(a);
+            updateReflex(c);
+
+            curr = a; // The previous corner may have just become an ear
+            sinceLastEar = 0;
+        } else {
+            curr = next[curr];
+            // Went all the way around without finding an ear: the polygon is
+            // self-intersecting or degenerate, so fan out whatever is left
+            if (++sinceLastEar > remaining) {
+                int first = curr;
+                for (int v = next[first]; next[v] != first; v = next[v])
+                    emit(first, v, next[v]);
+                return;
+            }
         }
     }
 
-    auto pointInTriangle = [&](const glm::vec2& P, const glm::vec2& A, const glm::vec2& B, const glm::vec2& C)
-    {
-        float c1 = (B.x - A.x) * (P.y - A.y) - (B.y - A.y) * (P.x - A.x);
-        float c2 = (C.x - B.x) * (P.y - B.y) - (C.y - B.y) * (P.x - B.x);
-        float c3 = (A.x - C.x) * (P.y - C.y) - (A.y - C.y) * (P.x - C.x);
+    // Final triangle
+    emit(prev[curr], curr, next[curr]);
+}
 
-        bool hasNeg = (c1 < 0) || (c2 < 0) || (c3 < 0);
-        bool hasPos = (c1 > 0) || (c2 > 0) || (c3 > 0);
+// Triangulate a polygonal face, appending the triangles to result
+static void triangulateFace(const std::vector<Vertex>& face, std::vector<Vertex>& result) {
+    int n = face.size();
+    if (n < 3) return;
 
-        return !(hasNeg && hasPos);
-    };
+    // Triangles go through untouched
+    if (n == 3) {
+        result.insert(result.end(), face.begin(), face.end());
+        return;
+    }
 
-    std::vector<int> indices(n);
-    for (int i = 0; i < n; ++i) indices[i] = i;
+    glm::vec3 N = polygonNormal(face);
+    float length = glm::length(N);
+    if (length < 1e-12f) {
+        // Degenerate face, keep the corners as a fan like a renderer would
+        for (int i = 1; i + 1 < n; ++i) {
+            result.push_back(face[0]);
+            result.push_back(face[i]);
+            result.push_back(face[i + 1]);
+        }
+        return;
+    }
+    N /= length;
+
+    // Convex quads are split along the 1-3 diagonal
+    if (n == 4) {
+        bool convex = true;
+        for (int i = 0; i < 4 && convex; ++i) {
+            const glm::vec3& a = face[(i + 3) % 4].point;
+            const glm::vec3& b = face[i].point;
+            const glm::vec3& c = face[(i + 1) % 4].point;
+            convex = glm::dot(glm::cross(b - a, c - b), N) > 0.0f;
+        }
+        if (convex) {
+            result.push_back(face[3]);
+            result.push_back(face[0]);
+            result.push_back(face[1]);
+            result.push_back(face[1]);
+            result.push_back(face[2]);
+            result.push_back(face[3]);
+            return;
+        }
+    }
 
-    while (indices.size() > 3) {
-        bool earFound = false;
+    earClip(face, N, result);
+}
 
-        for (int i = 0; i < (int)indices.size(); ++i) {
-            int prev = indices[(i + indices.size() - 1) % indices.size()];
-            int curr = indices[i];
-            int next = indices[(i + 1) % indices.size()];
+// Line scanning helpers for the memory mapped file
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
 
-            glm::vec2 &a = projected[prev];
-            glm::vec2 &b = projected[curr];
-            glm::vec2 &c = projected[next];
+static inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) ++p;
+    return p;
+}
 
-            // Convex check
-            float check = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
-            if (check <= 0.0f) continue;
+static inline const char* tokenEnd(const char* p, const char* end) {
+    while (p < end && !isBlank(*p)) ++p;
+    return p;
+}
 
-            // Check for vertices inside triangle
-            bool hasPointInside = false;
-            for (int j = 0; j < (int)indices.size(); ++j) {
-                int vi = indices[j];
-                if (vi == prev || vi == curr || vi == next) continue;
+static inline const char* parseFloat(const char* p, const char* end, float& out) {
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+') ++p; // from_chars doesn't accept a leading '+'
+    auto [ptr, ec] = std::from_chars(p, end, out);
+    if (ec != std::errc()) out = 0.0f;
+    return ptr;
+}
 
-                if (pointInTriangle(projected[vi], a, b, c)) {
-                    hasPointInside = true;
-                    break;
-                }
-            }
-            if (hasPointInside) continue;
+static inline const char* parseInt(const char* p, const char* end, int& out) {
+    if (p < end && *p == '+') ++p;
+    auto [ptr, ec] = std::from_chars(p, end, out);
+    if (ec != std::errc()) out = 0;
+    return ptr;
+}
 
-            result.push_back(face[prev]);
-            result.push_back(face[curr]);
-            result.push_back(face[next]);
-            indices.erase(indices.begin() + i);
-            earFound = true;
-            break;
+// Parse a face corner in the form v, v/vt, v//vn or v/vt/vn
+static inline const char* parseFaceVertex(const char* p, const char* end, FaceVertex& fv) {
+    p = parseInt(p, end, fv.v);
+    if (p < end && *p == '/') {
+        ++p;
+        if (p < end && *p != '/') p = parseInt(p, end, fv.vt);
+        if (p < end && *p == '/') {
+            ++p;
+            p = parseInt(p, end, fv.vn);
         }
-
-        if (!earFound) break; // No valid ear
     }
+    return tokenEnd(p, end);
+}
 
-    // Final triangle
-    if (indices.size() == 3) {
-        result.push_back(face[indices[0]]);
-        result.push_back(face[indices[1]]);
-        result.push_back(face[indices[2]]);
-    }
+// mtllib and usemtl statements in file order
+struct MaterialEvent {
+    bool isLibrary;
+    std::string name;
+};
 
-    return result;
-}
+// o and g statements in file order
+struct GroupEvent {
+    bool isObject;
+    std::string name;
+};
 
-std::vector<Face> OBJLoader::loadOBJ(const std::string& path) {
-    std::ifstream in(path);
-    if (!in.is_open()) {
-        std::cerr << "Failed to open OBJ file: " << path << "\n";
-        return {};
-    }
+struct ChunkFace {
+    size_t firstCorner;
+    size_t cornerCount;
+    int materialUse; // Number of usemtl statements seen in this chunk before the face
+    int groupUse;    // Same for o and g statements
+};
 
+// Everything a line-aligned chunk of the file contributes
+struct ChunkData {
     std::vector<glm::vec3> positions;
     std::vector<glm::vec3> normals;
     std::vector<glm::vec2> texcoords;
 
-    std::vector<Face> faces;
-    Material currentMaterial;
+    std::vector<FaceVertex> corners;
+    std::vector<ChunkFace> faces;
+    std::vector<MaterialEvent> materialEvents;
+    int materialUses = 0;
+    std::vector<GroupEvent> groupEvents;
 
-    std::string line, mtlFile, useMat;
-    while (std::getline(in, line)) {
-        std::istringstream ss(line);
-        std::string type;
-        ss >> type;
+    // Filled in by the prefix pass
+    int positionOffset = 0, normalOffset = 0, texcoordOffset = 0;
+    int materialOffset = 0;
+    int groupOffset = 0;
+
+    // Triangles produced by the second pass, materials hold nothing
+    OBJMesh result;
+    std::vector<unsigned int> smoothIndices; // Per result corner, only when smoothing
+};
+
+// Free the memory of a vector that's no longer needed
+template<typename T>
+static void releaseVector(std::vector<T>& v) {
+    std::vector<T>().swap(v);
+}
+
+// Turn a negative (relative) index into a chunk-local 1-based index
+static inline void resolveRelative(int& index, size_t localCount, unsigned char bit, unsigned char& mask) {
+    if (index < 0) {
+        index = (int)localCount + index + 1;
+        mask |= bit;
+    }
+}
+
+// First pass: parse the records of one chunk without looking at any other chunk
+static void parseChunk(const char* p, const char* end, ChunkData& chunk) {
+    while (p < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!lineEnd) lineEnd = end;
+
+        const char* typeBegin = skipBlanks(p, lineEnd);
+        const char* typeEnd = tokenEnd(typeBegin, lineEnd);
+        std::string_view type(typeBegin, typeEnd - typeBegin);
+        const char* cur = typeEnd;
 
         if (type == "v") {
             glm::vec3 v;
-            ss >> v.x >> v.y >> v.z;
-            positions.push_back(v);
+            cur = parseFloat(cur, lineEnd, v.x);
+            cur = parseFloat(cur, lineEnd, v.y);
+            cur = parseFloat(cur, lineEnd, v.z);
+            chunk.positions.push_back(v);
         }
         else if (type == "vn") {
             glm::vec3 n;
-            ss >> n.x >> n.y >> n.z;
-            normals.push_back(n);
+            cur = parseFloat(cur, lineEnd, n.x);
+            cur = parseFloat(cur, lineEnd, n.y);
+            cur = parseFloat(cur, lineEnd, n.z);
+            chunk.normals.push_back(n);
         }
         else if (type == "vt") {
             glm::vec2 t;
-            ss >> t.x >> t.y;
-            texcoords.push_back(t);
+            cur = parseFloat(cur, lineEnd, t.x);
+            cur = parseFloat(cur, lineEnd, t.y);
+            chunk.texcoords.push_back(t);
         }
-        else if (type == "mtllib") {
-            ss >> mtlFile;
+        else if (type == "mtllib" || type == "usemtl") {
+            const char* nameBegin = skipBlanks(cur, lineEnd);
+            chunk.materialEvents.push_back({type == "mtllib", std::string(nameBegin, tokenEnd(nameBegin, lineEnd))});
+            if (type == "usemtl") chunk.materialUses++;
         }
-        else if (type == "usemtl") {
-            ss >> useMat;
-            if (!mtlFile.empty()) {
-                std::filesystem::path mtlPath = std::filesystem::path(path).parent_path() / mtlFile;
-                currentMaterial.loadMTL(mtlPath.string(), useMat);
-            }
+        else if (type == "o" || type == "g") {
+            // The whole rest of the line, group names may contain spaces
+            const char* nameBegin = skipBlanks(cur, lineEnd);
+            const char* nameEnd = lineEnd;
+            while (nameEnd > nameBegin && isBlank(nameEnd[-1])) --nameEnd;
+            chunk.groupEvents.push_back({type == "o", std::string(nameBegin, nameEnd)});
         }
         else if (type == "f") {
-            std::vector<Vertex> faceVertices;
-            std::vector<glm::vec3> facePositions; // Face positions to calculate normals if any are missing
-            std::string vert;
+            ChunkFace face{chunk.corners.size(), 0, chunk.materialUses, (int)chunk.groupEvents.size()};
 
-            while (ss >> vert) {
+            while ((cur = skipBlanks(cur, lineEnd)) < lineEnd) {
                 FaceVertex fv;
-                std::replace(vert.begin(), vert.end(), '/', ' ');
-                std::stringstream tok(vert);
-                tok >> fv.v >> fv.vt >> fv.vn;
-
-                // Positions
-                glm::vec3 pos = (fv.v > 0 && fv.v <= (int)positions.size()) ? positions[fv.v - 1] : glm::vec3(0.0f);
-                facePositions.push_back(pos);
-
-                // Normal
-                glm::vec3 normal(0.0f);
-                if (fv.vn > 0 && fv.vn <= (int)normals.size()) {
-                    normal = normals[fv.vn - 1];
-                }
+                cur = parseFaceVertex(cur, lineEnd, fv);
+                resolveRelative(fv.v, chunk.positions.size(), RELATIVE_V, fv.relative);
+                resolveRelative(fv.vt, chunk.texcoords.size(), RELATIVE_VT, fv.relative);
+                resolveRelative(fv.vn, chunk.normals.size(), RELATIVE_VN, fv.relative);
+                chunk.corners.push_back(fv);
+            }
+
+            face.cornerCount = chunk.corners.size() - face.firstCorner;
+            chunk.faces.push_back(face);
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+// Second pass: resolve indices against the combined attribute arrays and triangulate
+static void buildChunkFaces(ChunkData& chunk,
+                            const std::vector<glm::vec3>& positions,
+                            const std::vector<glm::vec3>& normals,
+                            const std::vector<glm::vec2>& texcoords,
+                            const std::vector<unsigned int>& materialSlots,
+                            const std::vector<unsigned int>& groupSlots,
+                            bool smoothing) {
+    // Scratch buffers reused for every face
+    std::vector<Vertex> faceVertices;
+    std::vector<glm::vec3> facePositions; // Face positions to calculate normals if any are missing
+    std::vector<Vertex> triangles;
+
+    OBJMesh& out = chunk.result;
+    out.positions.reserve(chunk.faces.size() * 3);
+    out.normals.reserve(chunk.faces.size() * 3);
+    out.texcoords.reserve(chunk.faces.size() * 3);
+    out.materialIndices.reserve(chunk.faces.size());
+    out.groupIndices.reserve(chunk.faces.size());
+    if (smoothing) chunk.smoothIndices.reserve(chunk.faces.size() * 3);
+
+    for (const ChunkFace& face : chunk.faces) {
+        faceVertices.clear();
+        facePositions.clear();
+        triangles.clear();
+
+        for (size_t c = 0; c < face.cornerCount; ++c) {
+            FaceVertex fv = chunk.corners[face.firstCorner + c];
+            if (fv.relative & RELATIVE_V)  fv.v  += chunk.positionOffset;
+            if (fv.relative & RELATIVE_VT) fv.vt += chunk.texcoordOffset;
+            if (fv.relative & RELATIVE_VN) fv.vn += chunk.normalOffset;
+
+            // Positions
+            glm::vec3 pos = (fv.v > 0 && fv.v <= (int)positions.size()) ? positions[fv.v - 1] : glm::vec3(0.0f);
+            facePositions.push_back(pos);
+
+            // Normal
+            glm::vec3 normal(0.0f);
+            if (fv.vn > 0 && fv.vn <= (int)normals.size()) {
+                normal = normals[fv.vn - 1];
+            }
 
-                // Texture
-                glm::vec2 uv = (fv.vt > 0 && fv.vt <= (int)texcoords.size()) ? texcoords[fv.vt - 1] : glm::vec2(0.0f);
+            // Texture
+            glm::vec2 uv = (fv.vt > 0 && fv.vt <= (int)texcoords.size()) ? texcoords[fv.vt - 1] : glm::vec2(0.0f);
 
-                faceVertices.push_back({pos, normal, uv});
+            // Generated normals get smoothed over every corner at the same position record
+            unsigned int smoothIndex = ~0u;
+            if (smoothing && glm::length(normal) < 1e-6f && fv.v > 0 && fv.v <= (int)positions.size())
+                smoothIndex = fv.v - 1;
+
+            faceVertices.push_back({pos, normal, uv, smoothIndex});
+        }
+
+        // Compute fallback face normal if any vertex has missing normal
+        bool needFallback = false;
+        for (const auto &v : faceVertices) {
+            if (glm::length(v.normal) < 1e-6f) {
+                needFallback = true;
+                break;
             }
+        }
+        if (needFallback && facePositions.size() >= 3) {
+            glm::vec3 edge1 = facePositions[1] - facePositions[0];
+            glm::vec3 edge2 = facePositions[2] - facePositions[0];
+            glm::vec3 faceNormal = glm::normalize(glm::cross(edge1, edge2));
 
-            // Compute fallback face normal if any vertex has missing normal
-            bool needFallback = false;
-            for (const auto &v : faceVertices) {
+            for (auto &v : faceVertices) {
                 if (glm::length(v.normal) < 1e-6f) {
-                    needFallback = true;
-                    break;
+                    v.normal = faceNormal;
                 }
             }
-            if (needFallback && facePositions.size() >= 3) {
-                glm::vec3 edge1 = facePositions[1] - facePositions[0];
-                glm::vec3 edge2 = facePositions[2] - facePositions[0];
-                glm::vec3 faceNormal = glm::normalize(glm::cross(edge1, edge2));
-
-                for (auto &v : faceVertices) {
-                    if (glm::length(v.normal) < 1e-6f) {
-                        v.normal = faceNormal;
-                    }
+        }
+
+        // Triangulate face
+        triangulateFace(faceVertices, triangles);
+        for (const Vertex& v : triangles) {
+            out.positions.push_back(v.point);
+            out.normals.push_back(v.normal);
+            out.texcoords.push_back(v.texture);
+            if (smoothing) chunk.smoothIndices.push_back(v.smoothIndex);
+        }
+        out.materialIndices.insert(out.materialIndices.end(), triangles.size() / 3,
+                                   materialSlots[chunk.materialOffset + face.materialUse]);
+        out.groupIndices.insert(out.groupIndices.end(), triangles.size() / 3,
+                                groupSlots[chunk.groupOffset + face.groupUse]);
+    }
+}
+
+// Split [data, data + size) into count pieces that each end on a line break
+static std::vector<std::pair<const char*, const char*>> splitLines(const char* data, size_t size, size_t count) {
+    std::vector<std::pair<const char*, const char*>> ranges;
+    const char* end = data + size;
+    const char* begin = data;
+    for (size_t i = 1; i <= count && begin < end; ++i) {
+        const char* split = (i == count) ? end : data + size * i / count;
+        if (split < begin) split = begin;
+        if (split < end) {
+            const char* newline = static_cast<const char*>(memchr(split, '\n', end - split));
+            split = newline ? newline + 1 : end;
+        }
+        ranges.emplace_back(begin, split);
+        begin = split;
+    }
+    return ranges;
+}
+
+// Angle-weighted smooth normals for the corners with a smooth index. Corners sharing a
+// position record are averaged, skipping faces that meet at more than the crease angle.
+static void smoothNormals(OBJMesh& mesh, const std::vector<unsigned int>& smoothIndices,
+                          size_t positionCount, float creaseAngle, ThreadPool& pool) {
+    size_t cornerCount = smoothIndices.size();
+    size_t triangleCount = cornerCount / 3;
+    size_t blockCount = std::min<size_t>(pool.size() + 1, std::max<size_t>(triangleCount / 16384, 1));
+    auto blockRange = [&](size_t block, size_t count) {
+        return std::make_pair(count * block / blockCount, count * (block + 1) / blockCount);
+    };
+
+    // Unit face normal and the angle at each corner
+    std::vector<glm::vec3> faceNormals(triangleCount);
+    std::vector<float> cornerAngles(cornerCount);
+    pool.parallelFor(blockCount, [&](size_t block) {
+        auto [begin, end] = blockRange(block, triangleCount);
+        for (size_t t = begin; t < end; ++t) {
+            const glm::vec3* p = &mesh.positions[t * 3];
+            glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+            float length = glm::length(n);
+            faceNormals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+
+            for (int k = 0; k < 3; ++k) {
+                glm::vec3 e1 = p[(k + 1) % 3] - p[k];
+                glm::vec3 e2 = p[(k + 2) % 3] - p[k];
+                float l1 = glm::length(e1), l2 = glm::length(e2);
+                cornerAngles[t * 3 + k] = (l1 > 0.0f && l2 > 0.0f)
+                    ? std::acos(std::clamp(glm::dot(e1, e2) / (l1 * l2), -1.0f, 1.0f)) : 0.0f;
+            }
+        }
+    });
+
+    // Corners of every position record. Slots are claimed atomically, so each list is
+    // sorted afterwards to keep the summation order and the result deterministic.
+    std::unique_ptr<std::atomic<unsigned int>[]> cursor(new std::atomic<unsigned int>[positionCount]);
+    for (size_t v = 0; v < positionCount; ++v) cursor[v].store(0, std::memory_order_relaxed);
+    pool.parallelFor(blockCount, [&](size_t block) {
+        auto [begin, end] = blockRange(block, cornerCount);
+        for (size_t c = begin; c < end; ++c)
+            if (smoothIndices[c] != ~0u) cursor[smoothIndices[c]].fetch_add(1, std::memory_order_relaxed);
+    });
+
+    std::vector<unsigned int> adjacencyOffset(positionCount + 1, 0);
+    for (size_t v = 0; v < positionCount; ++v) {
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + cursor[v].load(std::memory_order_relaxed);
+        cursor[v].store(adjacencyOffset[v], std::memory_order_relaxed);
+    }
+
+    std::vector<unsigned int> adjacency(adjacencyOffset.back());
+    pool.parallelFor(blockCount, [&](size_t block) {
+        auto [begin, end] = blockRange(block, cornerCount);
+        for (size_t c = begin; c < end; ++c)
+            if (smoothIndices[c] != ~0u) adjacency[cursor[smoothIndices[c]].fetch_add(1, std::memory_order_relaxed)] = c;
+    });
+    cursor.reset();
+
+    pool.parallelFor(blockCount, [&](size_t block) {
+        auto [begin, end] = blockRange(block, positionCount);
+        for (size_t v = begin; v < end; ++v)
+            std::sort(adjacency.begin() + adjacencyOffset[v], adjacency.begin() + adjacencyOffset[v + 1]);
+    });
+
+    float creaseCos = std::cos(glm::radians(std::min(creaseAngle, 180.0f)));
+    pool.parallelFor(blockCount, [&](size_t block) {
+        auto [begin, end] = blockRange(block, cornerCount);
+        for (size_t c = begin; c < end; ++c) {
+            unsigned int v = smoothIndices[c];
+            if (v == ~0u) continue;
+
+            const glm::vec3& faceNormal = faceNormals[c / 3];
+            glm::vec3 normal(0.0f);
+            for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; ++a) {
+                unsigned int other = adjacency[a];
+                const glm::vec3& otherNormal = faceNormals[other / 3];
+                if (glm::dot(faceNormal, otherNormal) >= creaseCos)
+                    normal += otherNormal * cornerAngles[other];
+            }
+
+            // Keep the flat normal when everything cancels out
+            float length = glm::length(normal);
+            if (length > 1e-12f) mesh.normals[c] = normal / length;
+        }
+    });
+}
+
+OBJMesh OBJLoader::loadOBJ(const std::string& path, bool parallel, float creaseAngle) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        std::cerr << "Failed to open OBJ file: " << path << "\n";
+        return {};
+    }
+
+    // Chunks too small aren't worth the hand-off to another thread
+    constexpr size_t minChunkSize = 256 * 1024;
+    ThreadPool& pool = ThreadPool::shared();
+    size_t chunkCount = 1;
+    if (parallel)
+        chunkCount = std::clamp<size_t>(file.size() / minChunkSize, 1, pool.size() + 1);
+
+    auto ranges = splitLines(file.data(), file.size(), chunkCount);
+    std::vector<ChunkData> chunks(ranges.size());
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        parseChunk(ranges[i].first, ranges[i].second, chunks[i]);
+    });
+
+    // Prefix pass: global attribute offsets and the material state at each chunk start
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texcoords;
+
+    OBJMesh mesh;
+    mesh.materials.emplace_back(); // Default material for faces before any usemtl
+
+    // Material table slot after each usemtl, after the initial default
+    std::vector<unsigned int> materialSlots(1, 0);
+    std::unordered_map<const Material*, unsigned int> tableSlots;
+    unsigned int currentSlot = 0;
+    std::shared_ptr<const MaterialLibrary> library;
+
+    // Same for the groups, named by the last o and g statements
+    mesh.groups.emplace_back();
+    std::vector<unsigned int> groupSlots(1, 0);
+    std::unordered_map<std::string, unsigned int> groupTable{{"", 0}};
+    std::string objectName, groupName;
+
+    for (ChunkData& chunk : chunks) {
+        chunk.positionOffset = positions.size();
+        chunk.normalOffset = normals.size();
+        chunk.texcoordOffset = texcoords.size();
+        chunk.materialOffset = materialSlots.size() - 1;
+        chunk.groupOffset = groupSlots.size() - 1;
+
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+        releaseVector(chunk.positions);
+        releaseVector(chunk.normals);
+        releaseVector(chunk.texcoords);
+
+        for (const MaterialEvent& event : chunk.materialEvents) {
+            if (event.isLibrary) {
+                std::filesystem::path mtlPath = std::filesystem::path(path).parent_path() / event.name;
+                library = MaterialLibrary::load(mtlPath.string());
+                mesh.materialLibraries.push_back(mtlPath.string());
+                continue;
+            }
+            if (library) {
+                if (const Material* material = library->find(event.name)) {
+                    auto [it, inserted] = tableSlots.try_emplace(material, (unsigned int)mesh.materials.size());
+                    if (inserted) mesh.materials.push_back(*material);
+                    currentSlot = it->second;
                 }
             }
+            materialSlots.push_back(currentSlot);
+        }
 
-            // Triangulate face
-            auto tris = triangulateFace(faceVertices);
-            faces.push_back({tris, currentMaterial});
+        for (const GroupEvent& event : chunk.groupEvents) {
+            if (event.isObject) {
+                objectName = event.name;
+                groupName.clear();
+            } else {
+                groupName = event.name;
+            }
+            std::string name = objectName.empty() ? groupName
+                             : groupName.empty() ? objectName : objectName + "/" + groupName;
+            auto [it, inserted] = groupTable.try_emplace(name, (unsigned int)mesh.groups.size());
+            if (inserted) mesh.groups.push_back(name);
+            groupSlots.push_back(it->second);
         }
+        releaseVector(chunk.groupEvents);
     }
 
-    return faces;
+    bool smoothing = creaseAngle >= 0.0f;
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        buildChunkFaces(chunks[i], positions, normals, texcoords, materialSlots, groupSlots, smoothing);
+        releaseVector(chunks[i].corners);
+        releaseVector(chunks[i].faces);
+    });
+
+    // Concatenate the per chunk triangles straight into their final place
+    std::vector<size_t> cornerOffsets(chunks.size() + 1, 0);
+    for (size_t i = 0; i < chunks.size(); ++i)
+        cornerOffsets[i + 1] = cornerOffsets[i] + chunks[i].result.positions.size();
+
+    size_t cornerCount = cornerOffsets.back();
+    mesh.positions.resize(cornerCount);
+    mesh.normals.resize(cornerCount);
+    mesh.texcoords.resize(cornerCount);
+    mesh.materialIndices.resize(cornerCount / 3);
+    mesh.groupIndices.resize(cornerCount / 3);
+    std::vector<unsigned int> smoothIndices(smoothing ? cornerCount : 0);
+
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        OBJMesh& part = chunks[i].result;
+        size_t offset = cornerOffsets[i];
+        std::copy(part.positions.begin(), part.positions.end(), mesh.positions.begin() + offset);
+        std::copy(part.normals.begin(), part.normals.end(), mesh.normals.begin() + offset);
+        std::copy(part.texcoords.begin(), part.texcoords.end(), mesh.texcoords.begin() + offset);
+        std::copy(part.materialIndices.begin(), part.materialIndices.end(), mesh.materialIndices.begin() + offset / 3);
+        std::copy(part.groupIndices.begin(), part.groupIndices.end(), mesh.groupIndices.begin() + offset / 3);
+        std::copy(chunks[i].smoothIndices.begin(), chunks[i].smoothIndices.end(), smoothIndices.begin() + offset);
+        part = OBJMesh();
+        releaseVector(chunks[i].smoothIndices);
+    });
+
+    // Only worth it when some corner actually lacks a normal
+    if (std::any_of(smoothIndices.begin(), smoothIndices.end(), [](unsigned int i) { return i != ~0u; }))
+        smoothNormals(mesh, smoothIndices, positions.size(), creaseAngle, pool);
+
+    // Report parse throughput
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double megabytes = file.size() / (1024.0 * 1024.0);
+    std::cout << "Loaded " << path << ": " << megabytes << " MB in " << seconds * 1000.0 << " ms ("
+              << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s, " << chunks.size() << " chunks)" << std::endl;
+
+    return mesh;
 }
@@ -1,129 +1,103 @@
 #include "Object.h"
-#include "OBJLoader.h"
-#include <algorithm>
+#include "MeshRegistry.h"
+#include <glm/gtc/matrix_transform.hpp>
 
 Object::Object(const char* path, const Shader* shader) {
     this->shader = shader;
-
-    std::vector<Face> faces = OBJLoader::loadOBJ(path);
-
-    // Combine faces
-    for (auto& face : faces) {
-        int texIndex = -1;
-        if (face.material.diffuseTexture) {
-            auto it = std::find(textures.begin(), textures.end(), face.material.diffuseTexture);
-            if (it == textures.end()) {
-                textures.push_back(face.material.diffuseTexture);
-                texIndex = textures.size() - 1;
-            } else {
-                texIndex = it - textures.begin();
-            }
-        }
-
-        if (face.material.opacity < 1.0f) {
-            hasTransparency = true;
-        }
-
-        for (auto& v : face.vertices) {
-            vertices.push_back(v.point.x);
-            vertices.push_back(v.point.y);
-            vertices.push_back(v.point.z);
-
-            vertices.push_back(v.normal.x);
-            vertices.push_back(v.normal.y);
-            vertices.push_back(v.normal.z);
-
-            vertices.push_back(v.texture.x);
-            vertices.push_back(v.texture.y);
-
-            vertices.push_back(texIndex);
-
-            vertices.push_back(face.material.diffuseColor.r);
-            vertices.push_back(face.material.diffuseColor.g);
-            vertices.push_back(face.material.diffuseColor.b);
-
-            vertices.push_back(face.material.opacity);
-        }
-    }
-
-    // Generate VAO and VBO
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-    // Position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // Normal
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)(3*sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // Texture Coord
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)(6*sizeof(float)));
-    glEnableVertexAttribArray(2);
-    // Texture ID
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)(8*sizeof(float)));
-    glEnableVertexAttribArray(3);
-    // Diffuse Color
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)(9*sizeof(float)));
-    glEnableVertexAttribArray(4);
-    // Opacity
-    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, 13*sizeof(float), (void*)(12*sizeof(float)));
-    glEnableVertexAttribArray(5);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    mesh = MeshRegistry::instance().acquire(path);
 }
 
-void Object::draw(const glm::mat4 view, const glm::mat4 projection, std::vector<Light> &lights) {
-    if (!shader) return;
+Object::Object(std::shared_ptr<Mesh> mesh, const Shader* shader) {
+    this->shader = shader;
+    this->mesh = std::move(mesh);
+}
 
-    // Construct model matrix
+glm::mat4 Object::modelMatrix() const {
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, position);
     model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
     model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
     model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
     model = glm::scale(model, scale);
+    return model;
+}
 
-    shader->use();
-    shader->setMat4("projection", projection);
-    shader->setMat4("view", view);
-    shader->setMat4("model", model);
+void Object::draw(const glm::mat4 view, const glm::mat4 projection) {
+    Object* self = this;
+    drawInstanced(&self, &self + 1, view, projection);
+}
 
-    // Bind all textures
-    for (int i = 0; i < (int)textures.size(); ++i) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, textures[i]);
+void Object::drawInstanced(Object* const* begin, Object* const* end, const glm::mat4& view,
+                           const glm::mat4& projection, const Shader* shader) {
+    if (begin == end) return;
+    const Object& first = **begin;
+    if (!shader) shader = first.shader;
+    if (!shader || !first.loaded()) return;
+    const Mesh& mesh = *first.mesh;
+
+    // Scratch kept across batches so drawing doesn't allocate once they've grown, only
+    // ever used on the GL thread
+    static std::vector<InstanceData> instances;
+    static std::vector<glm::mat4> models;
+    static std::vector<Object*> visible;
+    static std::vector<GLsizei> counts;
+    static std::vector<const void*> offsets;
+    instances.clear();
+    models.clear();
+    visible.clear();
+
+    // Instances whose whole mesh is outside the frustum are dropped before anything is uploaded
+    for (Object* const* it = begin; it != end; ++it) {
+        Object* object = *it;
+        object->submittedTriangles = 0;
+        glm::mat4 model = object->modelMatrix();
+        if (!Frustum(projection * view * model).intersects(mesh.boundsMin, mesh.boundsMax)) continue;
+        instances.push_back({model, glm::vec4(object->tint, 1.0f)});
+        models.push_back(model);
+        visible.push_back(object);
     }
+    if (instances.empty()) return;
 
-    // Map each texture to their corresponding unit
-    std::vector<int> texUnits(textures.size());
-    for (int i = 0; i < (int)textures.size(); ++i)
-        texUnits[i] = i;
-    shader->setIntArray("textures", texUnits);
-
-    // Lighting
-    shader->setBool("useLighting", useLighting);
-    if (useLighting) {
-        shader->setInt("numLights", lights.size());
-        for (int i = 0; i < (int)lights.size(); ++i) {
-            shader->setVec3("lightPositions[" + std::to_string(i) + "]", lights[i].position);
-            shader->setVec3("lightColors[" + std::to_string(i) + "]", lights[i].color);
-            shader->setFloat("lightIntensities[" + std::to_string(i) + "]", lights[i].intensity);
-        }
+    if (instances.size() == 1) {
+        mesh.collectDrawRanges(models[0], view, projection, counts, offsets);
+    } else {
+        mesh.collectInstancedRanges(models, view, projection, counts, offsets);
     }
+    size_t triangles = 0;
+    for (GLsizei count : counts)
+        triangles += count / 3;
+    for (Object* object : visible)
+        object->submittedTriangles = triangles;
+    if (counts.empty()) return;
+
+    // Orphan the instance buffer every batch, the driver hands out fresh storage
+    if (instanceBuffer == 0)
+        glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceBuffer);
+
+    // View and projection come from the FrameData block, see Camera::uploadFrameData
+    shader->use();
+    if (mesh.compact) {
+        shader->setVec3("boundsMin", mesh.boundsMin);
+        shader->setVec3("boundsExtent", mesh.boundsMax - mesh.boundsMin);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, Mesh::MATERIAL_BINDING, mesh.materialBuffer);
+    }
+
+    // Lighting, the lights themselves are in the LightBuffer
+    shader->setBool("useLighting", first.useLighting);
     shader->setVec3("ambientLightColor", glm::vec3(1.0f));
     shader->setFloat("ambientLight", 0.1f);
 
-    // Bind VAO, draw call, unbind VAB
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 13);
+    // Bind VAO, draw call, unbind VAO
+    glBindVertexArray(mesh.VAO);
+    if (instances.size() == 1) {
+        glMultiDrawElements(GL_TRIANGLES, counts.data(), mesh.indexType, offsets.data(), counts.size());
+    } else {
+        for (size_t i = 0; i < counts.size(); ++i)
+            glDrawElementsInstanced(GL_TRIANGLES, counts[i], mesh.indexType, offsets[i], instances.size());
+    }
     glBindVertexArray(0);
-
-    // Unbind textures
-    for (int i = 0; i < (int)textures.size(); ++i)
-        glBindTexture(GL_TEXTURE_2D, 0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,561 @@
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include "TextureCooker.h"
+#include "STB/stb_image.h"
+#include <glad/gl.h>
+#include <iostream>
+#include <filesystem>
+#include <cstring>
+#include <algorithm>
+
+// S3TC is an extension the loader doesn't define, but every desktop driver has it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+static int mipLevels(int width, int height) {
+    int levels = 1;
+    while ((width | height) >> levels) levels++;
+    return levels;
+}
+
+static GLenum blockFormat(BlockFormat format, bool srgb) {
+    switch (format) {
+        case BlockFormat::BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+    }
+    return 0;
+}
+
+// The cooked file if it's at least as new as the image and was cooked with the same params
+static bool loadCooked(const std::string& path, const TextureParams& params, DecodedImage& image) {
+    std::string cookedPath = TextureCooker::cookedPath(path);
+    std::error_code ec;
+    auto cookedTime = std::filesystem::last_write_time(cookedPath, ec);
+    if (ec) return false;
+    auto sourceTime = std::filesystem::last_write_time(path, ec);
+    if (!ec && sourceTime > cookedTime) return false;
+
+    CookedTexture cooked;
+    if (!TextureCooker::load(cookedPath, cooked)) return false;
+    if (cooked.flipVertically != params.flipVertically) return false;
+    if (cooked.srgb != params.srgb) return false;
+    if ((int)cooked.levelSizes.size() != mipLevels(cooked.width, cooked.height)) return false;
+
+    static constexpr int CHANNELS[] = {0, 3, 0, 4, 1, 2};
+    image.width = cooked.width;
+    image.height = cooked.height;
+    image.channels = CHANNELS[(int)cooked.format];
+    image.compressedFormat = blockFormat(cooked.format, params.srgb);
+    image.levelSizes = std::move(cooked.levelSizes);
+    auto blocks = std::make_shared<std::vector<uint8_t>>(std::move(cooked.data));
+    image.pixels = std::shared_ptr<unsigned char>(blocks, blocks->data());
+    return true;
+}
+
+DecodedImage TextureCache::decode(const std::string& path, const TextureParams& params) {
+    DecodedImage image;
+    if (loadCooked(path, params, image)) return image;
+
+    stbi_set_flip_vertically_on_load_thread(params.flipVertically);
+    unsigned char *data = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+
+    if (!data) {
+        std::cout << "Failed to load texture: " << path << std::endl;
+        return image;
+    }
+
+    image.pixels = std::shared_ptr<unsigned char>(data, stbi_image_free);
+    return image;
+}
+
+static bool pixelFormat(const DecodedImage& image, const TextureParams& params, GLenum& format, GLenum& internalFormat) {
+    int channels = image.channels;
+    if (image.compressedFormat) { format = 0; internalFormat = image.compressedFormat; }
+    else if (channels == 1) { format = GL_RED; internalFormat = GL_R8; }
+    else if (channels == 3) { format = GL_RGB; internalFormat = params.srgb ? GL_SRGB8 : GL_RGB8; }
+    else if (channels == 4) { format = GL_RGBA; internalFormat = params.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8; }
+    else {
+        std::cout << "Unsupported number of channels: " << channels << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static unsigned int createArray(int width, int height, int levels, GLenum internalFormat, int layers) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, layers);
+    return texture;
+}
+
+// Fill one layer of the array from pixels, which is either client memory or an
+// offset into the bound pixel unpack buffer
+static void specifyLayer(unsigned int array, const DecodedImage& image, GLenum format, GLenum internalFormat,
+                         int levels, int layer, const void* pixels) {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+
+    if (image.compressedFormat) {
+        // Cooked with every level, nothing to generate
+        const char* level = static_cast<const char*>(pixels);
+        for (int i = 0; i < levels; ++i) {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, std::max(image.width >> i, 1),
+                                      std::max(image.height >> i, 1), 1, internalFormat,
+                                      (GLsizei)image.levelSizes[i], level);
+            level += image.levelSizes[i];
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return;
+    }
+
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, image.width, image.height, 1, format, GL_UNSIGNED_BYTE, pixels);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // Mipmaps of this layer only, through a 2D view of it. Regenerating the whole array
+    // would get slower with every texture added.
+    unsigned int view;
+    glGenTextures(1, &view);
+    glTextureView(view, GL_TEXTURE_2D, array, internalFormat, 0, levels, layer, 1);
+    glBindTexture(GL_TEXTURE_2D, view);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &view);
+}
+
+// A full mip chain adds about a third on top of the base level, cooked images have theirs already
+static size_t residentSize(const DecodedImage& image) {
+    return image.compressedFormat ? image.size() : image.size() * 4 / 3;
+}
+
+TextureCache& TextureCache::instance() {
+    // Decodes run on the shared pool and push into the cache, so the pool has to be
+    // constructed first to be destroyed (and joined) after the cache
+    ThreadPool::shared();
+    static TextureCache cache;
+    return cache;
+}
+
+std::string TextureCache::makeKey(const std::string& path, const TextureParams& params) {
+    std::error_code ec;
+    std::string key = std::filesystem::weakly_canonical(path, ec).string();
+    if (ec) key = path;
+    key += params.srgb ? "|srgb" : "|linear";
+    key += params.flipVertically ? "|flip" : "";
+    return key;
+}
+
+bool TextureCache::isResident(const std::string& path, const TextureParams& params) const {
+    std::string key = makeKey(path, params);
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.count(key) != 0;
+}
+
+unsigned int TextureCache::createHandle() {
+    if (arrays.empty()) {
+        // Single white texel shown until the real images arrive
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        TextureArray placeholder;
+        placeholder.width = placeholder.height = 1;
+        placeholder.internalFormat = GL_RGBA8;
+        placeholder.capacity = placeholder.layerCount = 1;
+        placeholder.texture = createArray(1, 1, 1, GL_RGBA8, 1);
+        const unsigned char white[4] = {255, 255, 255, 255};
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        arrays.push_back(placeholder);
+        counters.arrayCount++;
+        slots.assign(2, 0);
+    }
+
+    unsigned int handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        handle = slots.size() / 2;
+        slots.resize(slots.size() + 2);
+    }
+    setSlot(handle, 0, 0);
+    return handle;
+}
+
+void TextureCache::setSlot(unsigned int handle, int array, int layer) {
+    slots[handle * 2] = array;
+    slots[handle * 2 + 1] = layer;
+    slotsDirty = true;
+}
+
+void TextureCache::growArray(TextureArray& textureArray) {
+    int capacity = std::min(maxLayers, std::max(1, textureArray.capacity * 2));
+    unsigned int texture = createArray(textureArray.width, textureArray.height, textureArray.levels,
+                                       textureArray.internalFormat, capacity);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // Layers keep their index, so no handle has to change
+    if (textureArray.capacity > 0) {
+        for (int level = 0; level < textureArray.levels; ++level)
+            glCopyImageSubData(textureArray.texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                               texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                               std::max(1, textureArray.width >> level), std::max(1, textureArray.height >> level),
+                               textureArray.capacity);
+        glDeleteTextures(1, &textureArray.texture);
+    }
+    textureArray.texture = texture;
+    textureArray.capacity = capacity;
+}
+
+bool TextureCache::allocateLayer(int width, int height, unsigned int internalFormat, int& array, int& layer) {
+    auto it = std::find_if(arrays.begin() + 1, arrays.end(), [&](const TextureArray& a) {
+        return a.width == width && a.height == height && a.internalFormat == internalFormat;
+    });
+    if (it == arrays.end()) {
+        if (arrays.size() >= MAX_ARRAYS) {
+            std::cout << "Out of texture arrays for " << width << "x" << height << " images" << std::endl;
+            return false;
+        }
+        TextureArray textureArray;
+        textureArray.width = width;
+        textureArray.height = height;
+        textureArray.levels = mipLevels(width, height);
+        textureArray.internalFormat = internalFormat;
+        arrays.push_back(textureArray);
+        counters.arrayCount++;
+        it = arrays.end() - 1;
+    }
+    array = it - arrays.begin();
+
+    if (!it->freeLayers.empty()) {
+        layer = it->freeLayers.back();
+        it->freeLayers.pop_back();
+        return true;
+    }
+    if (it->layerCount == it->capacity) {
+        if (it->capacity >= maxLayers) {
+            std::cout << "Texture array " << width << "x" << height << " is full" << std::endl;
+            return false;
+        }
+        growArray(*it);
+    }
+    layer = it->layerCount++;
+    return true;
+}
+
+void TextureCache::freeLayer(int array, int layer) {
+    if (array > 0)
+        arrays[array].freeLayers.push_back(layer);
+}
+
+unsigned int TextureCache::acquire(const std::string& path, const TextureParams& params) {
+    std::string key = makeKey(path, params);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        counters.hits++;
+        it->second.refCount++;
+        return it->second.handle;
+    }
+
+    counters.misses++;
+    DecodedImage image = decode(path, params);
+    if (!image.valid()) return 0;
+
+    GLenum format, internalFormat;
+    if (!pixelFormat(image, params, format, internalFormat)) return 0;
+
+    Entry entry;
+    entry.handle = createHandle();
+    entry.generation = nextGeneration++;
+    if (!allocateLayer(image.width, image.height, internalFormat, entry.array, entry.layer)) {
+        freeHandles.push_back(entry.handle);
+        return 0;
+    }
+    const TextureArray& textureArray = arrays[entry.array];
+    specifyLayer(textureArray.texture, image, format, internalFormat, textureArray.levels, entry.layer, image.pixels.get());
+    setSlot(entry.handle, entry.array, entry.layer);
+
+    entry.bytes = residentSize(image);
+    entry.refCount = 1;
+    entry.params = params;
+    entry.timing.path = path;
+    entries.emplace(key, entry);
+    keysByHandle.emplace(entry.handle, key);
+    counters.textureCount++;
+    counters.residentBytes += entry.bytes;
+    return entry.handle;
+}
+
+unsigned int TextureCache::acquireAsync(const std::string& path, const TextureParams& params) {
+    std::string key = makeKey(path, params);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        counters.hits++;
+        it->second.refCount++;
+        return it->second.handle;
+    }
+    counters.misses++;
+
+    // Shows the placeholder until the real image arrives
+    unsigned int handle = createHandle();
+
+    Entry entry;
+    entry.handle = handle;
+    entry.generation = nextGeneration++;
+    entry.refCount = 1;
+    entry.state = State::Decoding;
+    entry.params = params;
+    entry.timing.path = path;
+    entries.emplace(key, entry);
+    keysByHandle.emplace(handle, key);
+    counters.textureCount++;
+    counters.pendingCount++;
+
+    ThreadPool::shared().submit([this, key, generation = entry.generation, path, params]() {
+        auto start = Clock::now();
+        DecodedImage image = decode(path, params);
+        double decodeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        decoded.push_back({key, generation, std::move(image), decodeMs});
+    });
+    return handle;
+}
+
+void TextureCache::release(unsigned int handle) {
+    if (handle == 0) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto keyIt = keysByHandle.find(handle);
+    if (keyIt == keysByHandle.end()) return;
+
+    auto it = entries.find(keyIt->second);
+    if (--it->second.refCount > 0) return;
+
+    // Streams still in flight for this texture are dropped when they arrive
+    freeLayer(it->second.array, it->second.layer);
+    setSlot(handle, 0, 0);
+    freeHandles.push_back(handle);
+    counters.textureCount--;
+    counters.residentBytes -= it->second.bytes;
+    if (it->second.state != State::Resident) counters.pendingCount--;
+    entries.erase(it);
+    keysByHandle.erase(keyIt);
+}
+
+bool TextureCache::allocateStaging(size_t size, size_t& offset) {
+    if (size > STAGING_SIZE) return false;
+
+    if (!stagingBuffer) {
+        // Persistently mapped, so the copy into it never has to sync with the driver
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &stagingBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, STAGING_SIZE, nullptr, flags);
+        stagingMemory = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, STAGING_SIZE, flags));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!stagingMemory) {
+            std::cout << "Failed to map texture staging buffer" << std::endl;
+            return false;
+        }
+    }
+    if (!stagingMemory) return false;
+
+    size = (size + 15) & ~size_t(15);
+
+    // Oldest upload that still holds part of the ring
+    auto oldest = std::find_if(inFlight.begin(), inFlight.end(),
+                               [](const InFlightUpload& upload) { return upload.size > 0; });
+    if (oldest == inFlight.end()) {
+        offset = 0;
+        stagingHead = size;
+        return true;
+    }
+
+    // Free space is [head, end) + [0, tail) when head is past the oldest upload,
+    // otherwise [head, tail). Never let head catch up with tail, that reads as empty.
+    size_t tail = oldest->offset;
+    if (stagingHead >= tail) {
+        if (stagingHead + size <= STAGING_SIZE) {
+            offset = stagingHead;
+        } else if (size < tail) {
+            offset = 0;
+        } else {
+            return false;
+        }
+    } else if (stagingHead + size < tail) {
+        offset = stagingHead;
+    } else {
+        return false;
+    }
+
+    stagingHead = offset + size;
+    return true;
+}
+
+void TextureCache::finishUpload(const std::string& key, uint64_t generation, double fenceMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.generation != generation || it->second.state != State::Uploading) return;
+
+    Entry& entry = it->second;
+    entry.state = State::Resident;
+    entry.timing.fenceMs = fenceMs;
+    counters.pendingCount--;
+    finishedTimings.push_back(entry.timing);
+
+    std::cout << "Streamed texture " << entry.timing.path << ": decode " << entry.timing.decodeMs
+              << " ms, upload " << entry.timing.uploadMs << " ms, GPU " << fenceMs << " ms" << std::endl;
+}
+
+void TextureCache::retireUploads() {
+    while (!inFlight.empty()) {
+        InFlightUpload& upload = inFlight.front();
+        GLsync fence = static_cast<GLsync>(upload.fence);
+        if (fence) {
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+            glDeleteSync(fence);
+        }
+
+        double fenceMs = std::chrono::duration<double, std::milli>(Clock::now() - upload.submitted).count();
+        finishUpload(upload.key, upload.generation, fenceMs);
+        inFlight.pop_front();
+    }
+}
+
+void TextureCache::update(double budgetMs) {
+    auto start = Clock::now();
+    retireUploads();
+
+    while (true) {
+        DecodeResult result;
+        {
+            std::lock_guard<std::mutex> lock(decodedMutex);
+            if (decoded.empty()) break;
+            result = std::move(decoded.front());
+            decoded.pop_front();
+        }
+
+        GLenum format, internalFormat;
+        int array, layer;
+        unsigned int arrayTexture;
+        int levels;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(result.key);
+            // Released meanwhile, maybe acquired again under the same key and handle
+            if (it == entries.end() || it->second.generation != result.generation ||
+                it->second.state != State::Decoding)
+                continue;
+            it->second.timing.decodeMs = result.decodeMs;
+
+            if (!result.image.valid() || !pixelFormat(result.image, it->second.params, format, internalFormat) ||
+                !allocateLayer(result.image.width, result.image.height, internalFormat, array, layer)) {
+                // Keep the placeholder so users still have a complete texture
+                it->second.state = State::Resident;
+                counters.pendingCount--;
+                continue;
+            }
+            arrayTexture = arrays[array].texture;
+            levels = arrays[array].levels;
+        }
+
+        size_t offset;
+        size_t size = result.image.size();
+        bool staged = allocateStaging(size, offset);
+        if (!staged && size <= STAGING_SIZE && !inFlight.empty()) {
+            // Ring is full, try again once some uploads have retired
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeLayer(array, layer);
+            }
+            std::lock_guard<std::mutex> lock(decodedMutex);
+            decoded.push_front(std::move(result));
+            break;
+        }
+
+        auto uploadStart = Clock::now();
+        if (staged) {
+            std::memcpy(stagingMemory + offset, result.image.pixels.get(), size);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+            specifyLayer(arrayTexture, result.image, format, internalFormat, levels, layer, reinterpret_cast<const void*>(offset));
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        } else {
+            // Bigger than the whole staging ring, upload straight from client memory
+            offset = 0;
+            size = 0;
+            specifyLayer(arrayTexture, result.image, format, internalFormat, levels, layer, result.image.pixels.get());
+        }
+
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        auto submitted = Clock::now();
+        double uploadMs = std::chrono::duration<double, std::milli>(submitted - uploadStart).count();
+
+        {
+            // Draws from now on sample the new layer, GL orders them after the upload
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(result.key);
+            if (it != entries.end() && it->second.generation == result.generation) {
+                it->second.array = array;
+                it->second.layer = layer;
+                setSlot(it->second.handle, array, layer);
+                it->second.state = State::Uploading;
+                it->second.timing.uploadMs = uploadMs;
+                it->second.bytes = residentSize(result.image);
+                counters.residentBytes += it->second.bytes;
+            } else {
+                // Released during the upload, the layer goes back to the pool
+                freeLayer(array, layer);
+            }
+        }
+        // Even a released texture holds its part of the staging ring until the fence
+        inFlight.push_back({result.key, result.generation, offset, size, fence, submitted});
+
+        double spent = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (spent >= budgetMs) break;
+    }
+}
+
+void TextureCache::bind() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (slotsDirty) {
+        if (!slotBuffer) glGenBuffers(1, &slotBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slotBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, slots.size() * sizeof(int), slots.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        slotsDirty = false;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SLOT_BINDING, slotBuffer);
+
+    for (size_t i = 0; i < arrays.size(); ++i) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i].texture);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+TextureStats TextureCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+std::vector<TextureTiming> TextureCache::timings() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return finishedTimings;
+}
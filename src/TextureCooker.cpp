@@ -0,0 +1,377 @@
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "STB/stb_image.h"
+#include <glm/glm.hpp>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+static constexpr char MAGIC[4] = {'C', 'T', 'E', 'X'};
+static constexpr uint32_t FLAG_SRGB = 1;
+static constexpr uint32_t FLAG_FLIPPED = 2;
+static constexpr uint32_t MAX_SIZE = 16384; // GL_MAX_TEXTURE_SIZE of current desktop GPUs
+
+std::string TextureCooker::cookedPath(const std::string& imagePath) {
+    return imagePath + ".ctex";
+}
+
+size_t TextureCooker::blockBytes(BlockFormat format) {
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+const char* TextureCooker::formatName(BlockFormat format) {
+    switch (format) {
+        case BlockFormat::BC1: return "BC1";
+        case BlockFormat::BC3: return "BC3";
+        case BlockFormat::BC4: return "BC4";
+        case BlockFormat::BC5: return "BC5";
+    }
+    return "?";
+}
+
+// Block encoders
+
+static uint16_t packColor(const glm::vec3& color) {
+    int r = std::clamp((int)std::round(color.r * 31.0f / 255.0f), 0, 31);
+    int g = std::clamp((int)std::round(color.g * 63.0f / 255.0f), 0, 63);
+    int b = std::clamp((int)std::round(color.b * 31.0f / 255.0f), 0, 31);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+static glm::vec3 unpackColor(uint16_t color) {
+    int r = color >> 11 & 31, g = color >> 5 & 63, b = color & 31;
+    return glm::vec3((r << 3 | r >> 2), (g << 2 | g >> 4), (b << 3 | b >> 2));
+}
+
+// Palette indices of the block for two packed endpoints, returns the squared error
+static float pickIndices(const glm::vec3 colors[16], uint16_t c0, uint16_t c1, uint8_t indices[16]) {
+    glm::vec3 palette[4];
+    palette[0] = unpackColor(c0);
+    palette[1] = unpackColor(c1);
+    palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+    palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+
+    float total = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float best = 1e30f;
+        for (int p = 0; p < 4; ++p) {
+            glm::vec3 d = colors[i] - palette[p];
+            float error = glm::dot(d, d);
+            if (error < best) { best = error; indices[i] = p; }
+        }
+        total += best;
+    }
+    return total;
+}
+
+// Endpoints that fit the chosen indices best in the least squares sense
+static bool refineEndpoints(const glm::vec3 colors[16], const uint8_t indices[16], glm::vec3& e0, glm::vec3& e1) {
+    static constexpr float WEIGHT[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    glm::vec3 ax(0.0f), bx(0.0f);
+    for (int i = 0; i < 16; ++i) {
+        float a = WEIGHT[indices[i]], b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        ax += a * colors[i];
+        bx += b * colors[i];
+    }
+    float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-6f) return false;
+    e0 = glm::clamp((ax * bb - bx * ab) / det, 0.0f, 255.0f);
+    e1 = glm::clamp((bx * aa - ax * ab) / det, 0.0f, 255.0f);
+    return true;
+}
+
+// Writes the 8 byte BC1 block, always in the four color mode so BC3 can share it
+static void encodeColorBlock(const glm::vec3 colors[16], uint8_t* out) {
+    glm::vec3 mean(0.0f);
+    for (int i = 0; i < 16; ++i) mean += colors[i];
+    mean /= 16.0f;
+
+    // Principal axis of the colors by power iteration on their covariance
+    glm::mat3 covariance(0.0f);
+    for (int i = 0; i < 16; ++i) {
+        glm::vec3 d = colors[i] - mean;
+        covariance += glm::outerProduct(d, d);
+    }
+    glm::vec3 axis(1.0f);
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 next = covariance * axis;
+        float length = glm::length(next);
+        if (length < 1e-6f) break;
+        axis = next / length;
+    }
+
+    float minT = 1e30f, maxT = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float t = glm::dot(colors[i] - mean, axis);
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    // Inset so the extremes land near the palette ends instead of past them
+    float inset = (maxT - minT) / 16.0f;
+    glm::vec3 e0 = glm::clamp(mean + axis * (maxT - inset), 0.0f, 255.0f);
+    glm::vec3 e1 = glm::clamp(mean + axis * (minT + inset), 0.0f, 255.0f);
+
+    uint16_t c0 = packColor(e0), c1 = packColor(e1);
+    uint8_t indices[16];
+    float error = pickIndices(colors, c0, c1, indices);
+
+    glm::vec3 r0, r1;
+    if (refineEndpoints(colors, indices, r0, r1)) {
+        uint16_t rc0 = packColor(r0), rc1 = packColor(r1);
+        uint8_t refined[16];
+        if (pickIndices(colors, rc0, rc1, refined) < error) {
+            c0 = rc0;
+            c1 = rc1;
+            std::memcpy(indices, refined, 16);
+        }
+    }
+
+    // c0 > c1 selects four colors, swapping the endpoints swaps indices 0/1 and 2/3
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        for (int i = 0; i < 16; ++i) indices[i] ^= 1;
+    } else if (c0 == c1) {
+        std::memset(indices, 0, 16);
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i) bits |= (uint32_t)indices[i] << (2 * i);
+    out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+    std::memcpy(out + 4, &bits, 4);
+}
+
+// Writes the 8 byte BC4 block of one channel, eight interpolated values between min and max
+static void encodeChannelBlock(const uint8_t values[16], uint8_t* out) {
+    uint8_t lo = 255, hi = 0;
+    for (int i = 0; i < 16; ++i) {
+        lo = std::min(lo, values[i]);
+        hi = std::max(hi, values[i]);
+    }
+    out[0] = hi;
+    out[1] = lo;
+
+    uint64_t bits = 0;
+    if (hi > lo) {
+        int palette[8] = {hi, lo};
+        for (int p = 2; p < 8; ++p) palette[p] = ((8 - p) * hi + (p - 1) * lo + 3) / 7;
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestError = 256;
+            for (int p = 0; p < 8; ++p) {
+                int error = std::abs(values[i] - palette[p]);
+                if (error < bestError) { bestError = error; best = p; }
+            }
+            bits |= (uint64_t)best << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; ++i) out[2 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+std::vector<uint8_t> TextureCooker::compress(const uint8_t* pixels, int width, int height, int channels,
+                                             BlockFormat format) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    size_t bytes = blockBytes(format);
+    std::vector<uint8_t> out((size_t)blocksX * blocksY * bytes);
+
+    // One row of blocks per task
+    ThreadPool::shared().parallelFor(blocksY, [&](size_t by) {
+        glm::vec3 colors[16];
+        uint8_t alpha[16], red[16], green[16];
+        for (int bx = 0; bx < blocksX; ++bx) {
+            for (int i = 0; i < 16; ++i) {
+                int x = std::min(bx * 4 + i % 4, width - 1);
+                int y = std::min((int)by * 4 + i / 4, height - 1);
+                const uint8_t* p = pixels + ((size_t)y * width + x) * channels;
+                colors[i] = channels >= 3 ? glm::vec3(p[0], p[1], p[2]) : glm::vec3(p[0]);
+                alpha[i] = channels == 4 ? p[3] : channels == 2 ? p[1] : 255;
+                red[i] = p[0];
+                green[i] = channels >= 2 ? p[1] : 0;
+            }
+
+            uint8_t* block = out.data() + ((size_t)by * blocksX + bx) * bytes;
+            switch (format) {
+                case BlockFormat::BC1: encodeColorBlock(colors, block); break;
+                case BlockFormat::BC3: encodeChannelBlock(alpha, block); encodeColorBlock(colors, block + 8); break;
+                case BlockFormat::BC4: encodeChannelBlock(red, block); break;
+                case BlockFormat::BC5: encodeChannelBlock(red, block); encodeChannelBlock(green, block + 8); break;
+            }
+        }
+    });
+    return out;
+}
+
+// Mip chain
+
+static float toLinear(uint8_t value) {
+    float c = value / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t fromLinear(float c) {
+    c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    return (uint8_t)std::clamp((int)std::round(c * 255.0f), 0, 255);
+}
+
+// Half size of the level by a 2x2 box filter, color channels of sRGB images averaged in
+// linear space and normals renormalized
+static std::vector<uint8_t> downsample(const std::vector<uint8_t>& src, int width, int height, int channels,
+                                       const CookOptions& options) {
+    int w = std::max(width / 2, 1), h = std::max(height / 2, 1);
+    std::vector<uint8_t> dst((size_t)w * h * channels);
+    int colorChannels = options.srgb && !options.normalMap && channels >= 3 ? 3 : 0;
+
+    ThreadPool::shared().parallelFor(h, [&](size_t y) {
+        for (int x = 0; x < w; ++x) {
+            float sum[4] = {};
+            for (int s = 0; s < 4; ++s) {
+                int sx = std::min(x * 2 + s % 2, width - 1);
+                int sy = std::min((int)y * 2 + s / 2, height - 1);
+                const uint8_t* p = src.data() + ((size_t)sy * width + sx) * channels;
+                for (int c = 0; c < channels; ++c)
+                    sum[c] += c < colorChannels ? toLinear(p[c]) : p[c] / 255.0f;
+            }
+            for (int c = 0; c < channels; ++c) sum[c] /= 4.0f;
+
+            if (options.normalMap && channels >= 2) {
+                glm::vec3 n(sum[0] * 2.0f - 1.0f, sum[1] * 2.0f - 1.0f, channels >= 3 ? sum[2] * 2.0f - 1.0f : 0.0f);
+                if (channels < 3) n.z = std::sqrt(std::max(1.0f - n.x * n.x - n.y * n.y, 0.0f));
+                n = glm::length(n) > 1e-6f ? glm::normalize(n) : glm::vec3(0.0f, 0.0f, 1.0f);
+                for (int c = 0; c < std::min(channels, 3); ++c) sum[c] = n[c] * 0.5f + 0.5f;
+            }
+
+            uint8_t* out = dst.data() + ((size_t)y * w + x) * channels;
+            for (int c = 0; c < channels; ++c)
+                out[c] = c < colorChannels ? fromLinear(sum[c])
+                                           : (uint8_t)std::clamp((int)std::round(sum[c] * 255.0f), 0, 255);
+        }
+    });
+    return dst;
+}
+
+static BlockFormat chooseFormat(const uint8_t* pixels, size_t pixelCount, int channels, const CookOptions& options) {
+    if (options.normalMap) return BlockFormat::BC5;
+    if (channels == 1) return BlockFormat::BC4;
+    if (channels == 3) return BlockFormat::BC1;
+
+    // Grey with alpha or RGBA, BC1 is enough when nothing is transparent
+    for (size_t i = 0; i < pixelCount; ++i)
+        if (pixels[i * channels + channels - 1] < 255) return BlockFormat::BC3;
+    return BlockFormat::BC1;
+}
+
+bool TextureCooker::cook(const std::string& imagePath, const std::string& outputPath, const CookOptions& options,
+                         CookedTexture& texture) {
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(options.flipVertically);
+    unsigned char* data = stbi_load(imagePath.c_str(), &width, &height, &channels, 0);
+    if (!data) {
+        std::cout << "Failed to load texture: " << imagePath << std::endl;
+        return false;
+    }
+
+    std::vector<uint8_t> level(data, data + (size_t)width * height * channels);
+    stbi_image_free(data);
+
+    // Grey images with alpha are expanded to RGBA so the color encoder sees three channels
+    if (channels == 2 && !options.normalMap) {
+        std::vector<uint8_t> rgba((size_t)width * height * 4);
+        for (size_t i = 0; i < (size_t)width * height; ++i) {
+            rgba[i * 4 + 0] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = level[i * 2];
+            rgba[i * 4 + 3] = level[i * 2 + 1];
+        }
+        level = std::move(rgba);
+        channels = 4;
+    }
+
+    texture = CookedTexture();
+    texture.format = chooseFormat(level.data(), (size_t)width * height, channels, options);
+    texture.width = width;
+    texture.height = height;
+    texture.srgb = options.srgb && !options.normalMap;
+    texture.flipVertically = options.flipVertically;
+
+    // Down to 1x1 like the runtime's texture arrays expect
+    int w = width, h = height;
+    while (true) {
+        std::vector<uint8_t> blocks = compress(level.data(), w, h, channels, texture.format);
+        texture.levelSizes.push_back(blocks.size());
+        texture.data.insert(texture.data.end(), blocks.begin(), blocks.end());
+        if (w == 1 && h == 1) break;
+        level = downsample(level, w, h, channels, options);
+        w = std::max(w / 2, 1);
+        h = std::max(h / 2, 1);
+    }
+
+    std::ofstream file(outputPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write cooked texture: " << outputPath << "\n";
+        return false;
+    }
+    uint32_t header[6] = {VERSION, (uint32_t)texture.format, (uint32_t)width, (uint32_t)height,
+                          (uint32_t)texture.levelSizes.size(),
+                          (texture.srgb ? FLAG_SRGB : 0) | (texture.flipVertically ? FLAG_FLIPPED : 0)};
+    file.write(MAGIC, sizeof(MAGIC));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (size_t size : texture.levelSizes) {
+        uint64_t size64 = size;
+        file.write(reinterpret_cast<const char*>(&size64), sizeof(size64));
+    }
+    file.write(reinterpret_cast<const char*>(texture.data.data()), texture.data.size());
+    if (!file) {
+        std::cerr << "Failed to write cooked texture: " << outputPath << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool TextureCooker::load(const std::string& path, CookedTexture& texture) {
+    MappedFile file(path);
+    if (!file.isOpen()) return false;
+
+    const char* p = file.data();
+    const char* end = p + file.size();
+    uint32_t header[6];
+    if ((size_t)(end - p) < sizeof(MAGIC) + sizeof(header) || std::memcmp(p, MAGIC, sizeof(MAGIC)) != 0) return false;
+    std::memcpy(header, p + sizeof(MAGIC), sizeof(header));
+    p += sizeof(MAGIC) + sizeof(header);
+
+    uint32_t format = header[1];
+    if (header[0] != VERSION || format < 1 || format > 5 || format == 2) return false;
+
+    uint32_t width = header[2], height = header[3];
+    if (width == 0 || height == 0 || width > MAX_SIZE || height > MAX_SIZE) return false;
+
+    texture = CookedTexture();
+    texture.format = (BlockFormat)format;
+    texture.width = (int)width;
+    texture.height = (int)height;
+    texture.srgb = header[5] & FLAG_SRGB;
+    texture.flipVertically = header[5] & FLAG_FLIPPED;
+
+    // The chain goes down to 1x1 and every level is exactly its blocks, which also keeps
+    // the total far from wrapping
+    uint32_t levels = header[4];
+    uint32_t chainLength = 1;
+    while ((std::max(width, height) >> chainLength) > 0) chainLength++;
+    if (levels != chainLength || (size_t)(end - p) < levels * sizeof(uint64_t)) return false;
+    size_t total = 0;
+    for (uint32_t i = 0; i < levels; ++i) {
+        uint64_t size;
+        std::memcpy(&size, p, sizeof(size));
+        p += sizeof(size);
+        uint64_t w = std::max(width >> i, 1u), h = std::max(height >> i, 1u);
+        if (size != ((w + 3) / 4) * ((h + 3) / 4) * blockBytes(texture.format)) return false;
+        texture.levelSizes.push_back(size);
+        total += size;
+    }
+    if ((size_t)(end - p) != total) return false;
+    texture.data.assign(p, end);
+    return true;
+}
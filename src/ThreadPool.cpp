@@ -0,0 +1,86 @@
+#include "ThreadPool.h"
+#include <atomic>
+#include <algorithm>
+#include <exception>
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    threadCount = std::max(threadCount, 1u);
+    workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+    if (count == 1) { fn(0); return; }
+
+    // Shared so helpers that only start after we returned still see valid state
+    struct State {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        size_t count = 0;
+        std::function<void(size_t)> fn;
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error; // First exception thrown by fn, rethrown to the caller
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->fn = fn;
+
+    auto run = [](State& s) {
+        size_t i;
+        while ((i = s.next.fetch_add(1)) < s.count) {
+            // A throwing index still counts as done, or the caller would wait forever
+            try {
+                s.fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                if (!s.error) s.error = std::current_exception();
+            }
+            if (s.done.fetch_add(1) + 1 == s.count) {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min<size_t>(count - 1, workers.size());
+    for (size_t i = 0; i < helpers; ++i)
+        submit([state, run]() { run(*state); });
+
+    run(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&] { return state->done.load() == count; });
+    if (state->error) std::rethrow_exception(state->error);
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
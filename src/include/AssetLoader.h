@@ -0,0 +1,50 @@
+#ifndef __ASSETLOADER_H__
+#define __ASSETLOADER_H__
+
+#include "Mesh.h"
+#include "MeshData.h"
+#include "ThreadPool.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <memory>
+
+// Loads meshes in the background. Parsing, triangulation and welding run on the
+// thread pool; the finished payloads are uploaded on the GL thread by update().
+// Textures are decoded and streamed separately by TextureCache.
+class AssetLoader {
+public:
+    explicit AssetLoader(ThreadPool& pool = ThreadPool::shared());
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    // Queue the OBJ file for mesh, which isn't drawn until it's uploaded.
+    // Usually called through MeshRegistry::acquireAsync so each file loads once.
+    void load(std::shared_ptr<Mesh> mesh, const std::string& path);
+
+    // Upload finished loads, stopping once budgetMs is spent. At least one
+    // payload is uploaded per call so progress is always made.
+    void update(double budgetMs);
+
+    // Nothing queued, loading or waiting for upload
+    bool idle();
+
+private:
+    struct Payload {
+        std::shared_ptr<Mesh> mesh;
+        std::string path;
+        MeshData data;
+        double loadMs;
+    };
+
+    ThreadPool& pool;
+    std::mutex mutex;
+    std::deque<Payload> ready;
+    std::vector<std::future<void>> jobs;
+};
+
+#endif
@@ -7,6 +7,17 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+// std140 layout of the FrameData uniform block in the shaders, constant for a frame
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPosition; // w unused
+    float time;
+    float padding[3];
+    glm::mat4 inverseViewProjection; // Clip space back to world space, for the deferred lighting pass
+};
+
 class Camera {
 public:
     glm::vec3 position{0.0f, 0.0f, 0.0f};
@@ -20,6 +31,8 @@ public:
     float turnSpeed = 60.0f;
     float sensitivity = 0.0025f;
 
+    static constexpr unsigned int FRAME_BINDING = 0;
+
     Camera() = default;
 
     // Constructor with position and quaternion
@@ -39,6 +52,13 @@ public:
         glm::mat4 transMat = glm::translate(glm::mat4(1.0f), -position);
         return rotMat * transMat;
     }
+
+    // Write this frame's FrameData and bind it to FRAME_BINDING for every program,
+    // once per frame before drawing. Time is in seconds.
+    void uploadFrameData(float time);
+
+private:
+    unsigned int frameBuffer = 0;
 };
 
 #endif
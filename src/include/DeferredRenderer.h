@@ -0,0 +1,43 @@
+#ifndef __DEFERREDRENDERER_H__
+#define __DEFERREDRENDERER_H__
+
+#include "Shader.h"
+
+// Deferred shading: opaque objects are drawn into a compact G-buffer (RGBA8 albedo with a
+// lit flag, RG16 snorm octahedral normal, 24 bit depth, 12 bytes a pixel), then one full
+// screen pass shades every pixel once with the clustered lights. Transparent objects stay
+// forward shaded on top, against the G-buffer's depth.
+class DeferredRenderer {
+public:
+    static constexpr unsigned int GBUFFER_UNIT = 16; // Albedo, normal and depth on this unit and the next two
+
+    // Fragment shader of the geometry pass, paired with the vertex shader of the objects
+    Shader geometryShader;
+
+    DeferredRenderer(const char* vertexPath);
+
+    DeferredRenderer(const DeferredRenderer&) = delete;
+    DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+    // Bind and clear the G-buffer, (re)created at the size of the viewport
+    void beginGeometry(int width, int height);
+
+    // Shade the G-buffer into the default framebuffer and copy its depth there, so
+    // forward passes after this depth test against the opaque objects
+    void shade(const glm::vec3& ambientColor, float ambient);
+
+    // Delete the G-buffer, while the context is still current
+    void release();
+
+private:
+    Shader lightingShader;
+    unsigned int framebuffer = 0;
+    unsigned int albedoTexture = 0, normalTexture = 0, depthTexture = 0;
+    unsigned int emptyVAO = 0; // Core profile needs one bound for the full screen triangle
+    int width = 0, height = 0;
+
+    void createTargets(int width, int height);
+    void deleteTargets();
+};
+
+#endif
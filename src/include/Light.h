@@ -7,6 +7,7 @@ struct Light {
     glm::vec3 position;
     glm::vec3 color;
     float intensity;
+    float radius = 10.0f; // Fades out to nothing here, lights only reach the clusters within it
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,34 @@
+#ifndef __LIGHTBUFFER_H__
+#define __LIGHTBUFFER_H__
+
+#include "Light.h"
+#include <vector>
+#include <cstddef>
+
+// The scene's lights in a shader storage buffer, read by every lit fragment.
+// Nothing about lights is set per draw, however many there are.
+class LightBuffer {
+public:
+    static constexpr unsigned int LIGHT_BINDING = 3;
+
+    // Called once per frame before drawing: uploads the lights if they differ from
+    // the last upload and binds the buffer to LIGHT_BINDING
+    void update(const std::vector<Light>& lights);
+
+    size_t lightCount() const { return uploaded.size(); }
+    size_t uploadCount() const { return uploads; }
+
+private:
+    // std430 layout of Lights in shaders/Shader.fs
+    struct GPULight {
+        glm::vec4 position;       // w radius
+        glm::vec4 colorIntensity; // rgb color, a intensity
+    };
+
+    unsigned int buffer = 0;
+    size_t capacity = 0; // Lights the buffer has room for
+    size_t uploads = 0;
+    std::vector<Light> uploaded;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef __LIGHTCLUSTERS_H__
+#define __LIGHTCLUSTERS_H__
+
+#include "Light.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct ClusterStats {
+    size_t indexCount = 0;    // Light references over all clusters
+    size_t maxPerCluster = 0;
+    double buildMs = 0.0;     // CPU time of the last update, upload included
+};
+
+// Result of LightClusters::validate
+struct ClusterCheck {
+    size_t points = 0;
+    size_t litPairs = 0; // Sample points and the lights reaching them, found by brute force
+    size_t missing = 0;  // Of those, lights absent from the list of the point's cluster
+};
+
+// Clustered forward lighting: the view frustum is cut into GRID_X x GRID_Y screen tiles
+// times GRID_Z exponentially spaced depth slices, and every cluster gets the indices of
+// the lights whose sphere touches it. Fragments only shade the lights of their cluster.
+class LightClusters {
+public:
+    static constexpr unsigned int GRID_X = 16, GRID_Y = 9, GRID_Z = 24;
+    static constexpr unsigned int CLUSTER_BINDING = 4; // Grid parameters and a range per cluster
+    static constexpr unsigned int INDEX_BINDING = 5;   // Light indices the ranges point into
+
+    // Once per frame before drawing: rebuilds the lists on the shared thread pool,
+    // uploads them and binds both buffers. Lights are indexed as in LightBuffer.
+    void update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+                float nearPlane, float farPlane, int viewportWidth, int viewportHeight);
+
+    const ClusterStats& stats() const { return lastStats; }
+
+    // Check the lists of the last update against every light: points spread over each
+    // cluster are looked up like Shader.fs does, and any light within its radius of a
+    // point has to be in that cluster's list. Slow, for the light benchmark only.
+    ClusterCheck validate(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+                          float nearPlane, float farPlane) const;
+
+private:
+    // std430 header of LightClusters in shaders/Shader.fs, followed by the ranges
+    struct GPUHeader {
+        glm::vec4 params; // near, GRID_Z / log(far / near), tile width, tile height in pixels
+        glm::uvec4 grid;  // GRID_X, GRID_Y, GRID_Z, unused
+    };
+
+    unsigned int clusterBuffer = 0, indexBuffer = 0;
+    ClusterStats lastStats;
+
+    // View space bounds per cluster, only rebuilt when the projection changes
+    std::vector<glm::vec3> boundsMin, boundsMax;
+    glm::mat4 boundsProjection = glm::mat4(0.0f);
+    float boundsNear = 0.0f, boundsFar = 0.0f;
+
+    std::vector<std::vector<uint32_t>> lists; // Light indices per cluster, capacity kept
+    std::vector<glm::uvec2> ranges;           // Offset and count per cluster
+    std::vector<uint32_t> indices;
+
+    void buildBounds(const glm::mat4& projection, float nearPlane, float farPlane);
+};
+
+#endif
@@ -3,15 +3,29 @@
 
 #include <glm/glm.hpp>
 #include <string>
+#include <memory>
+#include <unordered_map>
 
 class Material {
 public:
     std::string name;
     glm::vec3 diffuseColor = glm::vec3(0.8f);
     float opacity = 1.0f;
-    unsigned int diffuseTexture = 0;
+    std::string diffuseTexturePath; // Empty when untextured
+};
+
+// All materials of one .mtl file, keyed by their newmtl name
+class MaterialLibrary {
+public:
+    std::unordered_map<std::string, Material> materials;
+
+    const Material* find(const std::string& name) const;
+
+    // Parse the file the first time it's asked for, later calls share the same table
+    static std::shared_ptr<const MaterialLibrary> load(const std::string& path);
 
-    bool loadMTL(const std::string& path, const std::string &materialName);
+private:
+    bool parse(const std::string& path);
 };
 
-#endif
\ No newline at end of file
+#endif
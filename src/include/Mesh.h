@@ -0,0 +1,119 @@
+#ifndef __MESH_H__
+#define __MESH_H__
+
+#include "MeshData.h"
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// Planes of a clip transform, inside where dot(plane.xyz, p) + plane.w >= 0.
+// Built from projection * view * model the planes are in model space.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    explicit Frustum(const glm::mat4& clip);
+
+    bool intersects(const glm::vec3& center, float radius) const;
+    bool intersects(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+};
+
+// What a mesh keeps in RAM once it's on the GPU
+enum class Residency {
+    Discard,    // Nothing, the mesh can't be restored without loading the file again
+    Keep,       // The uploaded vertices and indices as they are
+    Compressed, // Both packed with MeshCodec, unpacked again by restore()
+};
+
+struct MemoryUsage {
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0; // Vertex, index and material buffers, textures are counted by TextureCache
+};
+
+// Immutable GPU copy of one mesh asset, shared by every object drawing it (see MeshRegistry).
+// Everything per instance, like the transform or tint, lives in Object.
+class Mesh {
+public:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int indexType = 0; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    unsigned int materialBuffer = 0; // Material table SSBO of the compact layout
+    bool hasTransparency = false;
+    bool loaded = false; // Nothing is drawn until the mesh is uploaded
+
+    size_t vertexCount = 0;
+    size_t indexCount = 0;             // Three per triangle, every LOD after another
+    std::vector<MeshData::Submesh> submeshes; // Culled and given a LOD one by one
+    std::vector<MeshData::Meshlet> meshlets;  // Clusters of the finest LODs, culled one by one
+    std::vector<unsigned int> textures; // TextureCache handles, what the uploaded texture IDs refer to
+
+    // Set before the upload, defaults to defaultResidency
+    Residency residency = defaultResidency;
+    static inline Residency defaultResidency = Residency::Discard;
+
+    std::vector<float> vertices;                   // Residency::Keep of the float layout, 13 floats each
+    std::vector<CompactVertex> compactVertexData;  // Residency::Keep of the compact layout
+    std::vector<unsigned int> indices;             // Residency::Keep
+    std::vector<uint8_t> packedVertices, packedIndices; // Residency::Compressed
+
+    // Upload meshes in the 16 byte layout of shaders/Compact.vs instead of 13 floats.
+    // Set before loading anything, the objects' shader has to match.
+    static inline bool compactVertices = false;
+    static constexpr unsigned int MATERIAL_BINDING = 0;
+
+    // The coarsest LOD whose error stays below this many pixels gets drawn
+    static inline float lodPixelError = 1.0f;
+    static inline int viewportHeight = 1080;
+
+    bool compact = false;                   // Layout this mesh was uploaded with
+    std::vector<CompactMaterial> materials; // Compact layout only
+
+    glm::vec3 boundsMin = glm::vec3(0.0f); // Model space AABB
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    // Create the GL buffers and start streaming the textures, must run on the GL thread
+    void upload(MeshData&& mesh);
+
+    // Recreate the GL buffers from what the residency policy kept, after the context and
+    // with it the old buffers were lost. The current ones are deleted first, so it also
+    // works on a live context; after a real loss call it before anything else creates GL
+    // objects. False, and the buffers are left alone, if there's nothing to restore from.
+    bool restore();
+
+    // Delete the GL buffers and drop the texture references, on the GL thread. Nothing
+    // is drawn afterwards, like before upload().
+    void release();
+
+    // Bytes per vertex of the uploaded layout
+    size_t vertexSize() const;
+
+    MemoryUsage memoryUsage() const;
+
+    // Coarsest LOD of the submesh within lodPixelError for the given transforms
+    size_t selectLOD(const MeshData::Submesh& submesh, const glm::mat4& model, const glm::mat4& view,
+                     const glm::mat4& projection) const;
+
+    // Index ranges to draw one instance: submeshes whose bounds are outside the frustum are
+    // skipped, the rest draw their selected LOD, at the finest one only the meshlets that are
+    // in the frustum and not facing away. Adjacent ranges are merged.
+    void collectDrawRanges(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+                           std::vector<GLsizei>& counts, std::vector<const void*>& offsets) const;
+
+    // Index ranges shared by several instances: every submesh that any of them sees, at the
+    // finest LOD any of them needs. Meshlets aren't culled since that depends on the instance.
+    void collectInstancedRanges(const std::vector<glm::mat4>& models, const glm::mat4& view,
+                                const glm::mat4& projection, std::vector<GLsizei>& counts,
+                                std::vector<const void*>& offsets) const;
+
+private:
+    size_t gpuBytes = 0;
+
+    void createBuffers(const void* vertexData, const std::vector<unsigned int>& indexData);
+    void deleteBuffers();
+    void setupFloatLayout();
+    void setupCompactLayout();
+
+    void addRange(unsigned int offset, unsigned int count, std::vector<GLsizei>& counts,
+                  std::vector<const void*>& offsets) const;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef __MESHCACHE_H__
+#define __MESHCACHE_H__
+
+#include "MeshData.h"
+#include <string>
+#include <vector>
+
+// Versioned binary copy of a built mesh, stored next to its source file.
+// An entry is valid while the source (by mtime and size, or else by content hash)
+// and every material library it depends on are unchanged.
+class MeshCache {
+public:
+    // Bump whenever the layout of MeshData or the file changes
+    static constexpr unsigned int VERSION = 8;
+
+    static std::string cachePath(const std::string& sourcePath);
+
+    // False when there is no entry or it's stale
+    static bool load(const std::string& sourcePath, MeshData& mesh);
+    static bool save(const std::string& sourcePath, const MeshData& mesh,
+                     const std::vector<std::string>& dependencies);
+};
+
+#endif
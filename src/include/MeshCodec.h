@@ -0,0 +1,22 @@
+#ifndef __MESHCODEC_H__
+#define __MESHCODEC_H__
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Lossless packing of vertex and index buffers, kept in RAM to re-upload meshes cheaply.
+// Both rely on the optimized order: neighbouring vertices are similar and indices are local.
+class MeshCodec {
+public:
+    // Each byte of the stride is delta coded against the previous vertex, zigzagged and
+    // bit packed in groups of 16 at the smallest width that fits (0, 1, 2, 4 or 8 bits)
+    static std::vector<uint8_t> encodeVertices(const void* vertices, size_t vertexCount, size_t stride);
+    static bool decodeVertices(const std::vector<uint8_t>& encoded, void* vertices, size_t vertexCount, size_t stride);
+
+    // Zigzagged difference to the previous index as a LEB128 varint
+    static std::vector<uint8_t> encodeIndices(const std::vector<unsigned int>& indices);
+    static bool decodeIndices(const std::vector<uint8_t>& encoded, std::vector<unsigned int>& indices, size_t indexCount);
+};
+
+#endif
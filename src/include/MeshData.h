@@ -0,0 +1,100 @@
+#ifndef __MESHDATA_H__
+#define __MESHDATA_H__
+
+#include "OBJLoader.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// 16 byte vertex of the compact layout, dequantized in shaders/Compact.vs
+struct CompactVertex {
+    uint16_t position[3]; // unorm16 relative to the mesh bounds
+    uint16_t material;    // Index into the material table
+    int16_t normal[2];    // Octahedral snorm16
+    uint16_t texcoord[2]; // Half floats
+};
+
+// Per-material values the compact layout moves out of the vertices, std430 layout
+struct CompactMaterial {
+    glm::vec3 diffuseColor = glm::vec3(0.0f);
+    float opacity = 1.0f;
+    int textureIndex = -1;
+    int padding[3] = {};
+};
+
+// CPU side of a mesh in the exact layout that gets uploaded to the GPU
+struct MeshData {
+    static constexpr size_t VERTEX_STRIDE = 13; // Floats per interleaved vertex
+    static constexpr float CREASE_ANGLE = 60.0f; // Degrees, for OBJ files without normals
+
+    std::vector<float> vertices;           // Welded interleaved vertices
+    std::vector<unsigned int> indices;     // Three per triangle, submeshes first and their LODs after
+    std::vector<std::string> texturePaths; // Indexed by the per-vertex texture ID
+
+    // Range of indices drawn at one level of detail, and its distance to the full mesh
+    struct LOD {
+        unsigned int indexOffset = 0;
+        unsigned int indexCount = 0;
+        float error = 0.0f; // Model space
+    };
+
+    // Cluster of triangles of the finest LOD, stored as one contiguous index range.
+    // It faces away from every eye where
+    // dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius
+    struct Meshlet {
+        unsigned int indexOffset = 0;
+        unsigned int indexCount = 0;
+        glm::vec3 center = glm::vec3(0.0f); // Bounding sphere
+        float radius = 0.0f;
+        glm::vec3 coneAxis = glm::vec3(0.0f);
+        float coneCutoff = 1.0f;            // Sine of the cone's half angle, 1 when it can't be culled
+    };
+    std::vector<Meshlet> meshlets;
+
+    // Triangles of one o/g group that share a material, contiguous in indices
+    struct Submesh {
+        std::string name;     // "object/group", empty before the first o or g
+        std::string material;
+        glm::vec3 boundsMin = glm::vec3(0.0f);
+        glm::vec3 boundsMax = glm::vec3(0.0f);
+        std::vector<LOD> lods; // Finest first, the first one covers the whole submesh
+        unsigned int meshletOffset = 0; // Meshlets of the finest LOD
+        unsigned int meshletCount = 0;
+    };
+    std::vector<Submesh> submeshes;
+
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    bool hasTransparency = false;
+
+    size_t vertexCount() const { return vertices.size() / VERTEX_STRIDE; }
+
+    static constexpr float LOD_RATIOS[] = {0.5f, 0.25f, 0.1f, 0.03f}; // Of the full triangle count
+
+    // Weld the triangle corners into unique vertices plus an index list
+    static MeshData fromOBJ(const OBJMesh& obj);
+
+    // Read the mesh cache, or parse the OBJ and refresh the cache. No GL calls,
+    // so it can run on any thread.
+    static MeshData load(const std::string& path);
+
+    // Copy of the vertices used by indices[indexOffset, indexOffset + indexCount) and
+    // that range renumbered to them, so passes over one submesh only allocate for its
+    // own vertices. globalIds maps the copies back.
+    void extract(size_t indexOffset, size_t indexCount, std::vector<float>& localVertices,
+                 std::vector<unsigned int>& localIndices, std::vector<unsigned int>& globalIds) const;
+
+    // Id per vertex, shared by every vertex at the same position. Ids are dense and
+    // numbered in order of first appearance.
+    static std::vector<unsigned int> positionIds(const std::vector<float>& vertices, size_t stride,
+                                                 size_t& positionCount);
+
+    // Quantize the vertices into the compact layout, with one table entry per
+    // distinct texture ID, diffuse colour and opacity
+    void compact(std::vector<CompactVertex>& compactVertices, std::vector<CompactMaterial>& materials) const;
+
+    void computeBounds();
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __MESHOPTIMIZER_H__
+#define __MESHOPTIMIZER_H__
+
+#include "MeshData.h"
+#include <vector>
+
+// Post-load reordering of indexed triangle lists for the GPU
+class MeshOptimizer {
+public:
+    // Post-transform cache efficiency of an index buffer
+    struct CacheStats {
+        float acmr = 0.0f; // Average cache miss ratio, vertices transformed per triangle (0.5 - 3.0)
+        float atvr = 0.0f; // Average transformed vertex ratio, vertices transformed per vertex (1.0+)
+    };
+
+    // Simulate a FIFO post-transform cache of cacheSize entries
+    static CacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+                                         unsigned int cacheSize = 16);
+
+    // Reorder triangles for post-transform cache locality (Forsyth's algorithm)
+    static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+    // Reorder the meshlets of each submesh so outward facing ones draw first, giving up at
+    // most threshold times the cache efficiency. Meshlets move whole and stay contiguous.
+    static void optimizeOverdraw(MeshData& mesh, float threshold = 1.05f);
+
+    // Reorder vertices by first use so vertex fetch walks memory sequentially
+    static void optimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices, size_t stride);
+
+    // Last step of a build, once meshlets (cache optimized each) and LODs exist: overdraw,
+    // then vertex fetch over every LOD. Logs the cache statistics of the finest LODs against
+    // before, measured on the welded order.
+    static void optimize(MeshData& mesh, const std::string& name, const CacheStats& before);
+};
+
+#endif
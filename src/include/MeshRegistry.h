@@ -0,0 +1,70 @@
+#ifndef __MESHREGISTRY_H__
+#define __MESHREGISTRY_H__
+
+#include "Mesh.h"
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <cstddef>
+
+class AssetLoader;
+
+struct MeshStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t meshCount = 0;
+};
+
+// One line of the memory report
+struct MeshMemory {
+    std::string path;
+    Residency residency = Residency::Discard;
+    size_t users = 0; // Objects sharing the mesh
+    MemoryUsage usage;
+};
+
+// Process-wide registry of GPU meshes keyed by canonical file path. Each asset is
+// parsed and uploaded once, every object using it shares the same Mesh.
+class MeshRegistry {
+public:
+    static MeshRegistry& instance();
+
+    // The mesh of path, loaded and uploaded right away on first use. The residency only
+    // applies when this call creates the mesh.
+    std::shared_ptr<Mesh> acquire(const std::string& path, Residency residency = Mesh::defaultResidency);
+
+    // Same, but the first request queues the load on loader and returns an empty mesh
+    // that loader.update() fills in, so objects never have to swap meshes
+    std::shared_ptr<Mesh> acquireAsync(const std::string& path, AssetLoader& loader,
+                                       Residency residency = Mesh::defaultResidency);
+
+    // Re-upload every mesh after the GL context was lost, returns how many could be restored
+    size_t restoreAll();
+
+    // Release and forget the meshes no object uses anymore, on the GL thread. Returns how
+    // many were evicted; a mesh still loading is held by its loader and stays.
+    size_t evictUnused();
+
+    // Release every mesh while the context is still current, at shutdown
+    void releaseAll();
+
+    MeshStats stats() const;
+
+    // CPU and GPU bytes of every mesh, sorted by path
+    std::vector<MeshMemory> memoryReport() const;
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Mesh>> meshes;
+    MeshStats counters;
+
+    MeshRegistry() = default;
+    static std::string makeKey(const std::string& path);
+
+    // Existing mesh of path, or a new empty one with created set
+    std::shared_ptr<Mesh> find(const std::string& path, Residency residency, bool& created);
+};
+
+#endif
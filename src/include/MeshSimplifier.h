@@ -0,0 +1,26 @@
+#ifndef __MESHSIMPLIFIER_H__
+#define __MESHSIMPLIFIER_H__
+
+#include "MeshData.h"
+#include <vector>
+#include <string>
+
+// Import time level of detail generation by edge collapse with quadric error metrics
+// (Garland & Heckbert). Collapses are half-edge collapses onto existing vertices, so
+// every LOD shares the vertex buffer of the full mesh.
+class MeshSimplifier {
+public:
+    // Simplify triangles toward each target (descending triangle counts) in one pass.
+    // Returns an index list per level that was reached, with the model space error
+    // (distance to the original surface) of each one.
+    static std::vector<std::vector<unsigned int>> simplify(const std::vector<float>& vertices, size_t stride,
+                                                           const std::vector<unsigned int>& indices,
+                                                           const std::vector<size_t>& targetTriangles,
+                                                           std::vector<float>& errors);
+
+    // Append LODs at the given fractions of each submesh's triangle count to mesh.indices
+    // and that submesh's lods, each reordered for the vertex cache
+    static void buildLODs(MeshData& mesh, const std::string& name, const std::vector<float>& ratios);
+};
+
+#endif
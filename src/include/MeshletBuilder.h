@@ -0,0 +1,24 @@
+#ifndef __MESHLETBUILDER_H__
+#define __MESHLETBUILDER_H__
+
+#include "MeshData.h"
+#include <vector>
+#include <string>
+
+// Splits indexed meshes into small clusters that can be culled on their own
+class MeshletBuilder {
+public:
+    static constexpr size_t MAX_VERTICES = 64;
+    static constexpr size_t MAX_TRIANGLES = 124;
+
+    // Group the triangles of indices[indexOffset, indexOffset + indexCount) into meshlets,
+    // rewriting that range so every meshlet is contiguous
+    static std::vector<MeshData::Meshlet> build(std::vector<unsigned int>& indices, size_t indexOffset,
+                                                size_t indexCount, const std::vector<float>& vertices,
+                                                size_t stride);
+
+    // Meshlets for the whole index list of mesh, before any LODs are added
+    static void build(MeshData& mesh, const std::string& name);
+};
+
+#endif
@@ -9,16 +9,31 @@ struct Vertex {
     glm::vec3 point;
     glm::vec3 normal;
     glm::vec2 texture;
+    unsigned int smoothIndex = ~0u; // Position record to smooth a generated normal over, ~0u to keep the normal
 };
 
-struct Face {
-    std::vector<Vertex> vertices;
-    Material material;
+// Triangulated contents of an OBJ file as flat arrays, three corners per triangle
+struct OBJMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texcoords;
+    std::vector<unsigned int> materialIndices; // One per triangle, into materials
+    std::vector<unsigned int> groupIndices;    // One per triangle, into groups
+
+    std::vector<Material> materials;           // Every material used, once
+    std::vector<std::string> materialLibraries; // Paths of all referenced .mtl files
+    std::vector<std::string> groups;            // "object/group" names from o and g, once each
+
+    size_t triangleCount() const { return materialIndices.size(); }
 };
 
 class OBJLoader {
 public:
-    static std::vector<Face> loadOBJ(const std::string& path);
+    // Large files are parsed in line-aligned chunks across the shared thread pool.
+    // Corners without a vn get smooth normals from the faces around their position,
+    // leaving edges sharper than creaseAngle degrees hard. A negative creaseAngle
+    // keeps flat face normals.
+    static OBJMesh loadOBJ(const std::string& path, bool parallel = true, float creaseAngle = -1.0f);
 };
 
 #endif
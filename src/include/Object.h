@@ -2,27 +2,58 @@
 #define __OBJECT_H__
 
 #include "Shader.h"
-#include "Light.h"
+#include "Mesh.h"
 #include <glm/glm.hpp>
 #include <vector>
+#include <memory>
 
+// Per instance data as read by the vertex shaders, std430
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 tint; // rgb multiplies the diffuse color of every material
+};
+
+// One placement of a shared mesh
 class Object {
 public:
     const Shader* shader = nullptr;
-    unsigned int VAO = 0, VBO = 0;
-    bool hasTransparency = false;
-
-    std::vector<float> vertices;
-    std::vector<unsigned int> textures;
+    std::shared_ptr<Mesh> mesh;
+    size_t submittedTriangles = 0; // By the last draw, after culling
 
     glm::vec3 position = glm::vec3(0.0f);
     glm::vec3 rotation = glm::vec3(0.0f);
     glm::vec3 scale = glm::vec3(1.0f);
+    glm::vec3 tint = glm::vec3(1.0f);
 
     bool useLighting = true;
 
+    static constexpr unsigned int INSTANCE_BINDING = 1;
+
+    // Load and upload synchronously, or share the mesh if it's already loaded
     Object(const char* path, const Shader* shader);
-    void draw(const glm::mat4 view, const glm::mat4 projection, std::vector<Light> &sceneLight);
+    // Instance of a mesh from MeshRegistry, drawn once the mesh is uploaded
+    Object(std::shared_ptr<Mesh> mesh, const Shader* shader);
+
+    bool loaded() const { return mesh && mesh->loaded; }
+
+    glm::mat4 modelMatrix() const;
+
+    void draw(const glm::mat4 view, const glm::mat4 projection);
+
+    // Draw objects that share their mesh, shader and useLighting with one instanced draw
+    // per index range. A single object also gets its meshlets culled. Textures and lights
+    // have to be bound already, see TextureCache::bind and LightBuffer::update. A shader
+    // given here replaces the objects' own one, like the geometry pass of deferred shading.
+    static void drawInstanced(Object* const* begin, Object* const* end, const glm::mat4& view,
+                              const glm::mat4& projection, const Shader* shader = nullptr);
+
+    // Whether two objects can be drawn by the same drawInstanced call
+    bool canInstanceWith(const Object& other) const {
+        return mesh == other.mesh && shader == other.shader && useLighting == other.useLighting;
+    }
+
+private:
+    static inline unsigned int instanceBuffer = 0; // Streamed SSBO of InstanceData
 };
 
-#endif
\ No newline at end of file
+#endif
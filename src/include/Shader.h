@@ -6,7 +6,9 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -70,7 +72,7 @@ public:
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-
+        cacheUniformLocations();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -78,103 +80,149 @@ public:
     {
         glUseProgram(ID);
     }
+    // location of an active uniform, or -1 which glUniform* ignores. Resolved once after
+    // linking, so this is a hash lookup instead of a string search in the driver.
+    // ------------------------------------------------------------------------
+    GLint uniformLocation(std::string_view name) const
+    {
+        auto it = uniformLocations.find(name);
+        return it == uniformLocations.end() ? -1 : it->second;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(std::string_view name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(uniformLocation(name), (int)value);
     }
-    void setBoolArray(const std::string &name, const std::vector<bool> &values) const
+    void setBoolArray(std::string_view name, const std::vector<bool> &values) const
     {
         std::vector<int> intValues(values.begin(), values.end());
-        glUniform1iv(glGetUniformLocation(ID, name.c_str()), intValues.size(), intValues.data());
+        glUniform1iv(uniformLocation(name), intValues.size(), intValues.data());
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(std::string_view name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(uniformLocation(name), value);
     }
-    void setIntArray(const std::string &name, const std::vector<int> &values) const
+    void setIntArray(std::string_view name, const std::vector<int> &values) const
     {
-        glUniform1iv(glGetUniformLocation(ID, name.c_str()), values.size(), values.data());
+        glUniform1iv(uniformLocation(name), values.size(), values.data());
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(std::string_view name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(uniformLocation(name), value);
     }
-    void setFloatArray(const std::string &name, const std::vector<float> &values) const
+    void setFloatArray(std::string_view name, const std::vector<float> &values) const
     {
-        glUniform1fv(glGetUniformLocation(ID, name.c_str()), values.size(), values.data());
+        glUniform1fv(uniformLocation(name), values.size(), values.data());
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(std::string_view name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(uniformLocation(name), 1, &value[0]);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(std::string_view name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(uniformLocation(name), x, y);
     }
-    void setVec2Array(const std::string &name, const std::vector<glm::vec2> &values) const
+    void setVec2Array(std::string_view name, const std::vector<glm::vec2> &values) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), values.size(), glm::value_ptr(values[0]));
+        glUniform2fv(uniformLocation(name), values.size(), glm::value_ptr(values[0]));
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(std::string_view name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(uniformLocation(name), 1, &value[0]);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(std::string_view name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(uniformLocation(name), x, y, z);
     }
-    void setVec3Array(const std::string &name, const std::vector<glm::vec3> &values) const
+    void setVec3Array(std::string_view name, const std::vector<glm::vec3> &values) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), values.size(), glm::value_ptr(values[0]));
+        glUniform3fv(uniformLocation(name), values.size(), glm::value_ptr(values[0]));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(std::string_view name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(uniformLocation(name), 1, &value[0]);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) const
+    void setVec4(std::string_view name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(uniformLocation(name), x, y, z, w);
     }
-    void setVec4Array(const std::string &name, const std::vector<glm::vec4> &values) const
+    void setVec4Array(std::string_view name, const std::vector<glm::vec4> &values) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), values.size(), glm::value_ptr(values[0]));
+        glUniform4fv(uniformLocation(name), values.size(), glm::value_ptr(values[0]));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(std::string_view name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
-    void setMat2Array(const std::string &name, const std::vector<glm::mat2> &values) const
+    void setMat2Array(std::string_view name, const std::vector<glm::mat2> &values) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), values.size(), GL_FALSE, glm::value_ptr(values[0]));
+        glUniformMatrix2fv(uniformLocation(name), values.size(), GL_FALSE, glm::value_ptr(values[0]));
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(std::string_view name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
-    void setMat3Array(const std::string &name, const std::vector<glm::mat3> &values) const
+    void setMat3Array(std::string_view name, const std::vector<glm::mat3> &values) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), values.size(), GL_FALSE, glm::value_ptr(values[0]));
+        glUniformMatrix3fv(uniformLocation(name), values.size(), GL_FALSE, glm::value_ptr(values[0]));
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(std::string_view name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
-    void setMat4Array(const std::string &name, const std::vector<glm::mat4> &values) const
+    void setMat4Array(std::string_view name, const std::vector<glm::mat4> &values) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), values.size(), GL_FALSE, glm::value_ptr(values[0]));
+        glUniformMatrix4fv(uniformLocation(name), values.size(), GL_FALSE, glm::value_ptr(values[0]));
     }
 
 private:
+    // heterogeneous lookup, so setters don't build a std::string per call
+    struct NameHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+    std::unordered_map<std::string, GLint, NameHash, std::equal_to<>> uniformLocations;
+
+    // introspect every active uniform of the linked program. Arrays are reported once as
+    // "name[0]", they're listed under that, their bare name and every other element.
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+        glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxLength);
+        std::vector<char> name(maxLength + 1);
+        const GLenum properties[] = {GL_LOCATION, GL_ARRAY_SIZE};
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLint values[2];
+            glGetProgramResourceiv(ID, GL_UNIFORM, i, 2, properties, 2, NULL, values);
+            if (values[0] < 0) continue; // member of a uniform block
+            glGetProgramResourceName(ID, GL_UNIFORM, i, name.size(), NULL, name.data());
+
+            std::string uniform = name.data();
+            uniformLocations[uniform] = values[0];
+            if (!uniform.ends_with("[0]")) continue;
+            std::string base = uniform.substr(0, uniform.size() - 3);
+            uniformLocations[base] = values[0];
+            for (GLint element = 1; element < values[1]; ++element)
+            {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                uniformLocations[elementName] = glGetProgramResourceLocation(ID, GL_UNIFORM, elementName.c_str());
+            }
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,184 @@
+#ifndef __TEXTURECACHE_H__
+#define __TEXTURECACHE_H__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// How an image is decoded and uploaded, part of the cache key
+struct TextureParams {
+    bool srgb = true;
+    bool flipVertically = true;
+};
+
+// Pixels decoded off the GL thread, waiting to be uploaded
+struct DecodedImage {
+    int width = 0, height = 0, channels = 0;
+    std::shared_ptr<unsigned char> pixels;
+
+    // Set for a cooked texture: its GL block format, pixels holds every mip level
+    unsigned int compressedFormat = 0;
+    std::vector<size_t> levelSizes;
+
+    bool valid() const { return pixels != nullptr; }
+    size_t size() const {
+        if (compressedFormat) {
+            size_t total = 0;
+            for (size_t levelSize : levelSizes) total += levelSize;
+            return total;
+        }
+        return (size_t)width * height * channels;
+    }
+};
+
+struct TextureStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t textureCount = 0;
+    size_t residentBytes = 0;
+    size_t pendingCount = 0; // Still decoding or uploading
+    size_t arrayCount = 0;   // Size buckets in use, including the placeholder
+};
+
+// Where the time of one streamed texture went
+struct TextureTiming {
+    std::string path;
+    double decodeMs = 0.0; // On a worker thread
+    double uploadMs = 0.0; // Staging copy and GL calls on the GL thread
+    double fenceMs = 0.0;  // From submitting the upload until the GPU was done with it
+};
+
+// Process-wide, reference counted cache of textures keyed by canonical file path.
+// Each image is decoded and uploaded once no matter how many materials use it.
+//
+// Images live in GL_TEXTURE_2D_ARRAYs, one per size and format, so all of them can be
+// bound once per frame by bind(). Users get a handle instead of a GL name; shaders look
+// up its array and layer in the slot table SSBO, see shaders/Shader.fs.
+class TextureCache {
+public:
+    // Texture units 0 .. MAX_ARRAYS - 1 hold the arrays
+    static constexpr unsigned int MAX_ARRAYS = 16;
+    static constexpr unsigned int SLOT_BINDING = 2;
+
+    static TextureCache& instance();
+
+    // Decode an image file, safe to call from any thread. A cooked block compressed
+    // version next to it (see TextureCooker) is used instead when it's up to date.
+    static DecodedImage decode(const std::string& path, const TextureParams& params = {});
+
+    bool isResident(const std::string& path, const TextureParams& params = {}) const;
+
+    // Returns a texture handle (0 on failure) and takes a reference to it.
+    // Decodes and uploads the file right away.
+    unsigned int acquire(const std::string& path, const TextureParams& params = {});
+
+    // Same, but returns at once with a handle showing a 1x1 white placeholder.
+    // The image is decoded on the thread pool and streamed into an array layer by
+    // update(), which only changes the handle's slot, so users never notice.
+    unsigned int acquireAsync(const std::string& path, const TextureParams& params = {});
+
+    // Drops a reference, the layer is freed once nothing uses it
+    void release(unsigned int handle);
+
+    // Called once per frame on the GL thread: copies decoded images into the
+    // persistently mapped staging buffer, issues the uploads and retires finished ones
+    void update(double budgetMs);
+
+    // Bind every array and the slot table, once per frame before drawing
+    void bind();
+
+    TextureStats stats() const;
+    std::vector<TextureTiming> timings() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class State { Decoding, Uploading, Resident };
+
+    struct Entry {
+        unsigned int handle = 0;
+        uint64_t generation = 0; // Handles are reused, this tells a re-acquired key from the released one
+        int array = 0, layer = 0; // The placeholder until resident
+        int refCount = 0;
+        size_t bytes = 0;
+        State state = State::Resident;
+        TextureParams params;
+        TextureTiming timing;
+    };
+
+    // Every image of one size and format, layers are reused once released
+    struct TextureArray {
+        unsigned int texture = 0;
+        int width = 0, height = 0, levels = 1;
+        unsigned int internalFormat = 0;
+        int capacity = 0;  // Allocated layers
+        int layerCount = 0; // Ever handed out, below capacity
+        std::vector<int> freeLayers;
+    };
+
+    struct DecodeResult {
+        std::string key;
+        uint64_t generation;
+        DecodedImage image;
+        double decodeMs;
+    };
+
+    // A staging region the GPU may still be reading from
+    struct InFlightUpload {
+        std::string key;
+        uint64_t generation;
+        size_t offset, size;
+        void* fence;
+        Clock::time_point submitted;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<unsigned int, std::string> keysByHandle;
+
+    // Array 0 is the white placeholder
+    std::vector<TextureArray> arrays;
+    int maxLayers = 0;
+
+    // Array and layer per handle as uploaded to slotBuffer, handle 0 is never used
+    std::vector<int> slots;
+    std::vector<unsigned int> freeHandles;
+    uint64_t nextGeneration = 1;
+    unsigned int slotBuffer = 0;
+    bool slotsDirty = false;
+
+    TextureStats counters;
+    std::vector<TextureTiming> finishedTimings;
+
+    std::mutex decodedMutex;
+    std::deque<DecodeResult> decoded;
+
+    // Pixel unpack buffer used as a ring, in-flight regions are freed in order
+    static constexpr size_t STAGING_SIZE = 32 * 1024 * 1024;
+    unsigned int stagingBuffer = 0;
+    unsigned char* stagingMemory = nullptr;
+    size_t stagingHead = 0;
+    std::deque<InFlightUpload> inFlight;
+
+    TextureCache() = default;
+    static std::string makeKey(const std::string& path, const TextureParams& params);
+
+    // Mutex held
+    unsigned int createHandle();
+    void setSlot(unsigned int handle, int array, int layer);
+    bool allocateLayer(int width, int height, unsigned int internalFormat, int& array, int& layer);
+    void growArray(TextureArray& textureArray);
+    void freeLayer(int array, int layer);
+
+    bool allocateStaging(size_t size, size_t& offset);
+    void retireUploads();
+    void finishUpload(const std::string& key, uint64_t generation, double fenceMs);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __TEXTURECOOKER_H__
+#define __TEXTURECOOKER_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// GPU block compressed formats of a cooked texture
+enum class BlockFormat : uint32_t {
+    BC1 = 1, // RGB, 4 bits per pixel
+    BC3 = 3, // RGBA, 8 bits per pixel
+    BC4 = 4, // One channel, 4 bits per pixel
+    BC5 = 5, // Two channels, normal map XY, 8 bits per pixel
+};
+
+struct CookOptions {
+    bool srgb = true;           // Mips are filtered in linear space and sampled through an sRGB format
+    bool flipVertically = true; // Has to match the TextureParams it's loaded with
+    bool normalMap = false;     // BC5 of red and green, mips renormalized
+};
+
+// Block data of every mip level down to 1x1, finest first
+struct CookedTexture {
+    BlockFormat format = BlockFormat::BC1;
+    int width = 0, height = 0;
+    bool srgb = true;
+    bool flipVertically = true;
+    std::vector<size_t> levelSizes;
+    std::vector<uint8_t> data; // All levels back to back
+};
+
+// Offline conversion of images into a small container (*.ctex next to the image) of
+// block compressed mip chains, which the runtime uploads without decoding or filtering.
+//
+// Layout, little endian: "CTEX", version, format, width, height, level count, flags
+// (1 sRGB, 2 flipped) as uint32, a uint64 byte size per level, then the levels.
+class TextureCooker {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    static std::string cookedPath(const std::string& imagePath);
+
+    // Decode the image, build its mip chain and compress every level, spread over the
+    // shared thread pool. The result is written to outputPath.
+    static bool cook(const std::string& imagePath, const std::string& outputPath, const CookOptions& options,
+                     CookedTexture& texture);
+
+    static bool load(const std::string& path, CookedTexture& texture);
+
+    // Compress one level of 8 bit pixels. BC1 and BC3 read RGB(A), BC4 the first and
+    // BC5 the first two channels; edge blocks repeat the last row and column.
+    static std::vector<uint8_t> compress(const uint8_t* pixels, int width, int height, int channels,
+                                         BlockFormat format);
+
+    static size_t blockBytes(BlockFormat format);
+    static const char* formatName(BlockFormat format);
+};
+
+#endif
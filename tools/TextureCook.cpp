@@ -0,0 +1,44 @@
+// Offline texture cooker: block compresses images with their mip chains into *.ctex
+// files next to them, which TextureCache loads instead of the images.
+//
+// Usage: TextureCook [--linear] [--normal] [--no-flip] image...
+#include "TextureCooker.h"
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+
+int main(int argc, char** argv) {
+    CookOptions options;
+    std::vector<std::string> images;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--linear") == 0) options.srgb = false;
+        else if (std::strcmp(argv[i], "--normal") == 0) { options.normalMap = true; options.srgb = false; }
+        else if (std::strcmp(argv[i], "--no-flip") == 0) options.flipVertically = false;
+        else images.push_back(argv[i]);
+    }
+    if (images.empty()) {
+        std::cout << "Usage: " << argv[0] << " [--linear] [--normal] [--no-flip] image..." << std::endl;
+        return 1;
+    }
+
+    int failed = 0;
+    for (const auto& image : images) {
+        auto start = std::chrono::steady_clock::now();
+        std::string output = TextureCooker::cookedPath(image);
+        CookedTexture texture;
+        if (!TextureCooker::cook(image, output, options, texture)) {
+            failed++;
+            continue;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::error_code ec;
+        size_t sourceBytes = std::filesystem::file_size(image, ec);
+        std::cout << "Cooked " << image << ": " << texture.width << "x" << texture.height << " "
+                  << TextureCooker::formatName(texture.format) << ", " << texture.levelSizes.size() << " levels, "
+                  << sourceBytes / 1024 << " KB -> " << texture.data.size() / 1024 << " KB in " << ms << " ms"
+                  << std::endl;
+    }
+    return failed ? 1 : 0;
+}